@@ -101,6 +101,23 @@ typedef enum
 }
 TLN_Blend;
 
+/*! Policy of the per-scanline sprite limit, see TLN_SetSpriteLimit() */
+typedef enum
+{
+	SPRITE_LIMIT_DROP,		/*!< drop the sprites at the back of the drawing order */
+	SPRITE_LIMIT_ROTATE,	/*!< change the dropped sprites each frame, so they flicker */
+}
+TLN_SpriteLimit;
+
+/*! Policy for memory allocations made during frames, see TLN_SetStrictAllocation() */
+typedef enum
+{
+	ALLOC_ALLOW,	/*!< allocations are allowed at any time (default) */
+	ALLOC_REPORT,	/*!< allocations between frames are logged as errors */
+	ALLOC_TRAP,		/*!< allocations between frames abort the program */
+}
+TLN_AllocationPolicy;
+
 /*! Affine transformation parameters */ 
 typedef struct
 {
@@ -120,6 +137,16 @@ typedef struct Tile
 }
 Tile;
 
+/*! Rectangular block of tiles inside a tilemap */
+typedef struct
+{
+	int row;		/*!< first row */
+	int col;		/*!< first column */
+	int rows;		/*!< number of rows */
+	int cols;		/*!< number of columns */
+}
+TLN_TileRect;
+
 /*! frame animation definition */
 typedef struct
 {
@@ -208,6 +235,26 @@ typedef struct
 }
 TLN_PixelMap;
 
+/*! object types reported by TLN_GetObjectAt() */
+typedef enum
+{
+	OBJECT_NONE,	/*!< background, nothing drawn */
+	OBJECT_SPRITE,	/*!< sprite */
+	OBJECT_TILE,	/*!< tile of a tiled layer */
+	OBJECT_LAYER,	/*!< layer without tile detail (bitmap, mosaic or reduced resolution) */
+}
+TLN_ObjectType;
+
+/*! object information returned by TLN_GetObjectAt() */
+typedef struct
+{
+	TLN_ObjectType type;	/*!< type of object */
+	int index;				/*!< sprite index or layer index */
+	int row;				/*!< row number in the tilemap for OBJECT_TILE */
+	int col;				/*!< col number in the tilemap for OBJECT_TILE */
+}
+TLN_ObjectInfo;
+
 typedef struct Engine*		 TLN_Engine;			/*!< Engine context */
 typedef struct Tile*		 TLN_Tile;				/*!< Tile reference */
 typedef struct Tileset*		 TLN_Tileset;			/*!< Opaque tileset reference */
@@ -217,12 +264,61 @@ typedef struct Spriteset*	 TLN_Spriteset;			/*!< Opaque sspriteset reference */
 typedef struct Sequence*	 TLN_Sequence;			/*!< Opaque sequence reference */
 typedef struct SequencePack* TLN_SequencePack;		/*!< Opaque sequence pack reference */
 typedef struct Bitmap*		 TLN_Bitmap;			/*!< Opaque bitmap reference */
+typedef struct Snapshot*	 TLN_Snapshot;			/*!< Opaque engine state snapshot */
 
 /* callbacks */
 typedef union SDL_Event SDL_Event;
 typedef void(*TLN_VideoCallback)(int scanline);
 typedef void(*TLN_SDLCallback)(SDL_Event*);
 
+/*! raster interrupt for TLN_SetRasterInterrupts() */
+typedef struct
+{
+	int line;					/*!< scanline that triggers the interrupt */
+	TLN_VideoCallback callback;	/*!< function to call, or NULL to call the raster callback */
+}
+TLN_RasterInterrupt;
+
+/*! operations of raster programs, see TLN_SetRasterProgram() */
+typedef enum
+{
+	RASTER_END,				/*!< ends the program for the current line */
+	RASTER_PUSH,			/*!< pushes value */
+	RASTER_LINE,			/*!< pushes the current scanline */
+	RASTER_TIME,			/*!< pushes the timestamp of the current frame */
+	RASTER_TABLE,			/*!< pops an index, pushes that entry of the table, wrapping around */
+	RASTER_DUP,				/*!< pushes a copy of the top value */
+	RASTER_ADD,				/*!< pops b and a, pushes a + b */
+	RASTER_SUB,				/*!< pops b and a, pushes a - b */
+	RASTER_MUL,				/*!< pops b and a, pushes a * b */
+	RASTER_DIV,				/*!< pops b and a, pushes a / b, or 0 if b is 0 */
+	RASTER_MOD,				/*!< pops b and a, pushes a modulo b with the sign of b, or 0 if b is 0 */
+	RASTER_MIN,				/*!< pops b and a, pushes the lowest */
+	RASTER_MAX,				/*!< pops b and a, pushes the highest */
+	RASTER_SIN,				/*!< pops a, pushes the sine of a degrees */
+	RASTER_COS,				/*!< pops a, pushes the cosine of a degrees */
+	RASTER_LESS,			/*!< pops b and a, pushes 1 if a < b or 0 otherwise */
+	RASTER_GREATER,			/*!< pops b and a, pushes 1 if a > b or 0 otherwise */
+	RASTER_SELECT,			/*!< pops c, b and a, pushes a if c is not 0 or b otherwise */
+	RASTER_SKIP,			/*!< pops c, skips the next param operations if c is 0 */
+	RASTER_LAYER_X,			/*!< pops x, sets the horizontal position of layer param */
+	RASTER_LAYER_Y,			/*!< pops y, sets the vertical position of layer param */
+	RASTER_LAYER_SCALING,	/*!< pops sy and sx, sets the scaling of layer param */
+	RASTER_BG_COLOR,		/*!< pops b, g and r, sets the background color */
+	RASTER_PALETTE_COLOR,	/*!< pops b, g, r and index, sets that entry of the palette of layer param */
+	MAX_RASTER_OP,
+}
+TLN_RasterOpcode;
+
+/*! operation of a raster program for TLN_SetRasterProgram() */
+typedef struct
+{
+	TLN_RasterOpcode opcode;	/*!< operation */
+	int param;					/*!< layer index, or number of operations to skip */
+	float value;				/*!< value pushed by RASTER_PUSH */
+}
+TLN_RasterOp;
+
 /*! Player index for input assignment functions */
 typedef enum
 {
@@ -265,6 +361,16 @@ typedef enum
 }
 TLN_Input;
 
+/*! input transition for TLN_GetInputEvent() */
+typedef struct
+{
+	uint32_t time;		/*!< timestamp in milliseconds, same clock as TLN_GetTicks() */
+	TLN_Player player;	/*!< player the input belongs to */
+	TLN_Input input;	/*!< input that changed, INPUT_UP to INPUT_START */
+	bool pressed;		/*!< true if pressed, false if released */
+}
+TLN_InputEvent;
+
 /*! CreateWindow flags. Can be none or a combination of the following: */
 typedef enum
 {
@@ -300,6 +406,8 @@ typedef enum
 	TLN_ERR_WRONG_FORMAT,	/*!< Resource file has invalid format */
 	TLN_ERR_WRONG_SIZE,		/*!< A width or height parameter is invalid */
 	TLN_ERR_UNSUPPORTED,	/*!< Unsupported function */
+	TLN_ERR_REF_SNAPSHOT,	/*!< Invalid TLN_Snapshot reference */
+	TLN_ERR_IDX_LIGHT,		/*!< Light index out of range */
 	TLN_MAX_ERR,
 }
 TLN_Error;
@@ -339,8 +447,14 @@ TLNAPI void TLN_SetBGColor (uint8_t r, uint8_t g, uint8_t b);
 TLNAPI bool TLN_SetBGColorFromTilemap (TLN_Tilemap tilemap);
 TLNAPI void TLN_DisableBGColor (void);
 TLNAPI bool TLN_SetBGBitmap (TLN_Bitmap bitmap);
+TLNAPI void TLN_SetPremultipliedOutput (bool enable);
 TLNAPI bool TLN_SetBGPalette (TLN_Palette palette);
+TLNAPI void TLN_SetColorMatrix (const float* matrix);
+TLNAPI bool TLN_SetColorLUT (const uint8_t* lut, int size);
+TLNAPI void TLN_SetGlobalFade (uint8_t r, uint8_t g, uint8_t b, uint8_t factor);
 TLNAPI void TLN_SetRasterCallback (TLN_VideoCallback);
+TLNAPI bool TLN_SetRasterInterrupts (TLN_RasterInterrupt* interrupts, int count);
+TLNAPI bool TLN_SetRasterProgram (const TLN_RasterOp* program, int count, const float* table, int tablesize);
 TLNAPI void TLN_SetFrameCallback (TLN_VideoCallback);
 TLNAPI void TLN_SetRenderTarget (uint8_t* data, int pitch);
 TLNAPI void TLN_UpdateFrame (int time);
@@ -348,6 +462,12 @@ TLNAPI void TLN_BeginFrame (int time);
 TLNAPI bool TLN_DrawNextScanline (void);
 TLNAPI void TLN_SetLoadPath (const char* path);
 TLNAPI void TLN_SetCustomBlendFunction (uint8_t (*blend_function)(uint8_t src, uint8_t dst));
+TLNAPI bool TLN_SetTileCache (int numtiles);
+TLNAPI void TLN_SetPreflippedGraphics (bool enable);
+TLNAPI bool TLN_SetObjectIdBuffer (bool enable);
+TLNAPI bool TLN_GetObjectAt (int x, int y, TLN_ObjectInfo* info);
+TLNAPI void TLN_SetStrictAllocation (TLN_AllocationPolicy policy);
+TLNAPI uint32_t TLN_GetFrameAllocations (void);
 TLNAPI void TLN_SetLogLevel(TLN_LogLevel log_level);
 
 /**@}*/
@@ -373,6 +493,7 @@ TLNAPI void TLN_SetWindowTitle (const char* title);
 TLNAPI bool TLN_ProcessWindow (void);
 TLNAPI bool TLN_IsWindowActive (void);
 TLNAPI bool TLN_GetInput (TLN_Input id);
+TLNAPI bool TLN_GetInputEvent (TLN_InputEvent* event);
 TLNAPI void TLN_EnableInput (TLN_Player player, bool enable);
 TLNAPI void TLN_AssignInputJoystick (TLN_Player player, int index);
 TLNAPI void TLN_DefineInputKey (TLN_Player player, TLN_Input input, uint32_t keycode);
@@ -412,6 +533,7 @@ TLNAPI bool TLN_DeleteSpriteset (TLN_Spriteset Spriteset);
  * Tileset resources management for background layers */
 /**@{*/
 TLNAPI TLN_Tileset TLN_CreateTileset (int numtiles, int width, int height, TLN_Palette palette, TLN_SequencePack sp, TLN_TileAttributes* attributes);
+TLNAPI TLN_Tileset TLN_CreateVirtualTileset (const char* filename, int offset, int numtiles, int width, int height, TLN_Palette palette, TLN_TileAttributes* attributes, int numresident);
 TLNAPI TLN_Tileset TLN_LoadTileset (const char* filename);
 TLNAPI TLN_Tileset TLN_CloneTileset (TLN_Tileset src);
 TLNAPI bool TLN_SetTilesetPixels (TLN_Tileset tileset, int entry, uint8_t* srcdata, int srcpitch);
@@ -437,6 +559,11 @@ TLNAPI TLN_Tileset TLN_GetTilemapTileset (TLN_Tilemap tilemap);
 TLNAPI bool TLN_GetTilemapTile (TLN_Tilemap tilemap, int row, int col, TLN_Tile tile);
 TLNAPI bool TLN_SetTilemapTile (TLN_Tilemap tilemap, int row, int col, TLN_Tile tile);
 TLNAPI bool TLN_CopyTiles (TLN_Tilemap src, int srcrow, int srccol, int rows, int cols, TLN_Tilemap dst, int dstrow, int dstcol);
+TLNAPI bool TLN_SetTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, const Tile* tiles, int pitch);
+TLNAPI bool TLN_StampTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, const Tile* tiles, int pitch);
+TLNAPI bool TLN_FillTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, TLN_Tile tile);
+TLNAPI int  TLN_GetTilemapDirtyRects (TLN_Tilemap tilemap, TLN_TileRect* rects, int maxrects);
+TLNAPI bool TLN_ClearTilemapDirtyRects (TLN_Tilemap tilemap);
 TLNAPI bool TLN_DeleteTilemap (TLN_Tilemap tilemap);
 /**@}*/
 
@@ -473,6 +600,8 @@ TLNAPI int TLN_GetBitmapPitch (TLN_Bitmap bitmap);
 TLNAPI TLN_Palette TLN_GetBitmapPalette (TLN_Bitmap bitmap);
 TLNAPI bool TLN_SetBitmapPalette (TLN_Bitmap bitmap, TLN_Palette palette);
 TLNAPI bool TLN_DeleteBitmap (TLN_Bitmap bitmap);
+TLNAPI bool TLN_RenderTilemapToBitmap (TLN_Tilemap tilemap, TLN_Tileset tileset, int x, int y, int width, int height, TLN_Bitmap bitmap, bool smooth);
+TLNAPI bool TLN_RenderLayerToBitmap (int nlayer, int x, int y, int width, int height, TLN_Bitmap bitmap, bool smooth);
 /**@}*/
 
 /** 
@@ -488,18 +617,36 @@ TLNAPI bool TLN_SetLayerScaling (int nlayer, float xfactor, float yfactor);
 TLNAPI bool TLN_SetLayerAffineTransform (int nlayer, TLN_Affine *affine);
 TLNAPI bool TLN_SetLayerTransform (int layer, float angle, float dx, float dy, float sx, float sy);
 TLNAPI bool TLN_SetLayerPixelMapping (int nlayer, TLN_PixelMap* table);
+TLNAPI bool TLN_SetLayerBlockedLayout (int nlayer, bool enable);
 TLNAPI bool TLN_SetLayerBlendMode (int nlayer, TLN_Blend mode, uint8_t factor);
 TLNAPI bool TLN_SetLayerColumnOffset (int nlayer, int* offset);
 TLNAPI bool TLN_SetLayerClip (int nlayer, int x1, int y1, int x2, int y2);
 TLNAPI bool TLN_DisableLayerClip (int nlayer);
 TLNAPI bool TLN_SetLayerMosaic (int nlayer, int width, int height);
 TLNAPI bool TLN_DisableLayerMosaic (int nlayer);
+TLNAPI bool TLN_SetLayerResolution (int nlayer, int xdivisor, int ydivisor, bool smooth);
 TLNAPI bool TLN_ResetLayerMode (int nlayer);
 TLNAPI bool TLN_DisableLayer (int nlayer);
 TLNAPI TLN_Palette TLN_GetLayerPalette (int nlayer);
 TLNAPI bool TLN_GetLayerTile (int nlayer, int x, int y, TLN_TileInfo* info);
 TLNAPI int  TLN_GetLayerWidth (int nlayer);
 TLNAPI int  TLN_GetLayerHeight (int nlayer);
+TLNAPI bool TLN_SetTextLayer (int nlayer, TLN_Tileset font, int rows, int cols, char first);
+TLNAPI bool TLN_SetLayerText (int nlayer, int row, int col, const char* text);
+TLNAPI bool TLN_ClearLayerText (int nlayer);
+
+/**@}*/
+
+/** 
+ * \anchor group_light
+ * \name Lighting
+ * Low resolution light map */
+/**@{*/
+TLNAPI bool TLN_SetLightMap (int cellsize, int numlights);
+TLNAPI void TLN_SetAmbientLight (uint8_t r, uint8_t g, uint8_t b);
+TLNAPI bool TLN_SetLight (int nlight, int x, int y, int radius, uint8_t r, uint8_t g, uint8_t b);
+TLNAPI bool TLN_DisableLight (int nlight);
+TLNAPI void TLN_DisableLightMap (void);
 
 /**@}*/
 
@@ -525,6 +672,11 @@ TLNAPI bool TLN_EnableSpriteCollision (int nsprite, bool enable);
 TLNAPI bool TLN_GetSpriteCollision (int nsprite);
 TLNAPI bool TLN_DisableSprite (int nsprite);
 TLNAPI TLN_Palette TLN_GetSpritePalette (int nsprite);
+TLNAPI bool TLN_SetSpriteDrawOrder (const int* order, int count);
+TLNAPI bool TLN_SetSpriteSortKey (int nsprite, int key);
+TLNAPI void TLN_EnableSpriteSorting (bool enable);
+TLNAPI bool TLN_SetSpriteLimit (int sprites, int pixels, TLN_SpriteLimit mode);
+TLNAPI int  TLN_GetCulledSpriteLines (void);
 /**@}*/
 
 /** 
@@ -570,6 +722,16 @@ TLNAPI int  TLN_GetAvailableAnimation (void);
 TLNAPI bool TLN_DisableAnimation (int index);
 /**@}*/
 
+/** 
+ * \anchor group_snapshot
+ * \name Snapshots 
+ * Capture and restore of the engine state */
+/**@{*/
+TLNAPI TLN_Snapshot TLN_CreateSnapshot (void);
+TLNAPI bool TLN_RestoreSnapshot (TLN_Snapshot snapshot);
+TLNAPI bool TLN_DeleteSnapshot (TLN_Snapshot snapshot);
+/**@}*/
+
 #ifdef __cplusplus
 }
 #endif
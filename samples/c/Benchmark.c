@@ -5,7 +5,9 @@
 #define HRES		400
 #define VRES		240
 #define NUM_SPRITES	250
+#define MANY_SPRITES	1000
 #define NUM_FRAMES	2000
+#define LARGE_MAP	1024
 
 static int pixels;
 
@@ -18,6 +20,7 @@ int main (int argc, char* argv[])
 	uint8_t* framebuffer;
 	uint32_t version;
 	TLN_Tilemap tilemap;
+	TLN_Tilemap largemap;
 	TLN_Spriteset spriteset;
 	TLN_SpriteInfo sprite_info;
 
@@ -45,6 +48,20 @@ int main (int argc, char* argv[])
 	printf ("Normal layer..........");
 	Profile ();
 
+	printf ("Cached layer..........");
+	TLN_SetTileCache (1024);
+	Profile ();
+	TLN_SetTileCache (0);
+
+	printf ("Half resolution layer.");
+	TLN_SetLayerResolution (0, 2, 2, false);
+	Profile ();
+
+	printf ("Smooth half res layer.");
+	TLN_SetLayerResolution (0, 2, 2, true);
+	Profile ();
+	TLN_SetLayerResolution (0, 1, 1, false);
+
 	printf ("Scaling layer.........");
 	TLN_SetLayerScaling (0, 2.0f, 2.0f);
 	Profile ();
@@ -53,6 +70,34 @@ int main (int argc, char* argv[])
 	TLN_SetLayerTransform (0, 45.0f, 0.0f, 0.0f, 1.0f, 1.0f);
 	Profile ();
 
+	printf ("Blocked affine layer..");
+	TLN_SetLayerBlockedLayout (0, true);
+	Profile ();
+	TLN_SetLayerBlockedLayout (0, false);
+
+	/* large map, zoomed out: tile rows far apart in memory, cache misses dominate */
+	largemap = TLN_CreateTilemap (LARGE_MAP, LARGE_MAP, NULL, 0, NULL);
+	for (c=0; c<LARGE_MAP*LARGE_MAP; c+=TLN_GetTilemapCols (tilemap))
+	{
+		int row = c / LARGE_MAP;
+		int col = c % LARGE_MAP;
+		TLN_CopyTiles (tilemap, row % TLN_GetTilemapRows (tilemap), 0, 1, TLN_GetTilemapCols (tilemap), largemap, row, col);
+	}
+	TLN_SetLayer (0, TLN_GetTilemapTileset (tilemap), largemap);
+	TLN_SetLayerTransform (0, 45.0f, 0.0f, 0.0f, 0.25f, 0.25f);
+
+	printf ("Large affine layer....");
+	Profile ();
+
+	printf ("Large blocked affine..");
+	TLN_SetLayerBlockedLayout (0, true);
+	Profile ();
+	TLN_SetLayerBlockedLayout (0, false);
+
+	TLN_SetLayer (0, NULL, tilemap);
+	TLN_DeleteTilemap (largemap);
+	TLN_SetLayerTransform (0, 45.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
 	printf ("Blend layer...........");
 	TLN_ResetLayerMode (0);
 	TLN_SetLayerBlendMode (0, BLEND_MIX, 128);
@@ -88,6 +133,42 @@ int main (int argc, char* argv[])
 		TLN_EnableSpriteCollision (c, true);
 	Profile ();
 
+	printf ("Flipped sprites.......");
+	for (c=0; c<NUM_SPRITES; c++)
+	{
+		TLN_EnableSpriteCollision (c, false);
+		TLN_SetSpriteFlags (c, FLAG_FLIPX);
+	}
+	Profile ();
+
+	printf ("Pre-flipped sprites...");
+	TLN_SetPreflippedGraphics (true);
+	Profile ();
+	TLN_SetPreflippedGraphics (false);
+
+	/* many sprites spread over the screen: most slots don't cover a given scanline. Runs in
+	 * its own context so the cases above keep NUM_SPRITES slots */
+	TLN_Deinit ();
+	TLN_SetContext (TLN_Init (HRES, VRES, 0, MANY_SPRITES, 0));
+	TLN_SetRenderTarget (framebuffer, HRES*4);
+	TLN_DisableBGColor ();
+	pixels = 0;
+	for (c=0; c<MANY_SPRITES; c++)
+	{
+		int x = (c*37) % HRES;
+		int y = (c*53) % VRES;
+		TLN_ConfigSprite (c, spriteset, FLAG_NONE);
+		TLN_SetSpritePicture (c, 0);
+		TLN_SetSpritePosition (c, x, y);
+
+		/* only the visible part is drawn */
+		pixels += (x + sprite_info.w > HRES? HRES - x : sprite_info.w) *
+			(y + sprite_info.h > VRES? VRES - y : sprite_info.h);
+	}
+
+	printf ("Many sprites..........");
+	Profile ();
+
 	free (framebuffer);
 	TLN_DeleteTilemap (tilemap);
 	TLN_Deinit ();
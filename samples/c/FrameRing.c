@@ -0,0 +1,157 @@
+/******************************************************************************
+*
+* Tilengine sample
+* http://www.tilengine.org
+*
+* Ring of frames in POSIX shared memory. See FrameRing.h
+*
+******************************************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "FrameRing.h"
+
+/* single producer, single consumer: acquire/release ordering is enough */
+#define load_acquire(ptr)		__atomic_load_n (ptr, __ATOMIC_ACQUIRE)
+#define store_release(ptr,val)	__atomic_store_n (ptr, val, __ATOMIC_RELEASE)
+
+static bool Map (FrameRing* ring, int fd, size_t size)
+{
+	void* data = mmap (NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	ring->header = (FrameRingHeader*)data;
+	ring->base = (uint8_t*)data + sizeof(FrameRingHeader);
+	ring->size = size;
+	return true;
+}
+
+/* creates a new ring, replacing any previous one with the same name */
+bool FrameRingCreate (FrameRing* ring, const char* name, int width, int height, int numslots)
+{
+	const uint32_t pitch = width*4;
+	const uint32_t slotsize = (sizeof(FrameRingSlot) + pitch*height + FRAMERING_ALIGN - 1) & ~(FRAMERING_ALIGN - 1);
+	const size_t size = sizeof(FrameRingHeader) + (size_t)slotsize*numslots;
+	int fd;
+
+	memset (ring, 0, sizeof(FrameRing));
+	strncpy (ring->name, name, sizeof(ring->name) - 1);
+	shm_unlink (name);
+	fd = shm_open (name, O_CREAT|O_EXCL|O_RDWR, 0600);
+	if (fd == -1)
+		return false;
+
+	if (ftruncate (fd, size) != 0 || !Map (ring, fd, size))
+	{
+		shm_unlink (name);
+		return false;
+	}
+
+	ring->owner = true;
+	ring->header->width = width;
+	ring->header->height = height;
+	ring->header->pitch = pitch;
+	ring->header->numslots = numslots;
+	ring->header->slotsize = slotsize;
+	store_release (&ring->header->magic, FRAMERING_MAGIC);
+	return true;
+}
+
+/* opens a ring created by another process */
+bool FrameRingOpen (FrameRing* ring, const char* name)
+{
+	FrameRingHeader header;
+	int fd;
+
+	memset (ring, 0, sizeof(FrameRing));
+	strncpy (ring->name, name, sizeof(ring->name) - 1);
+	fd = shm_open (name, O_RDWR, 0600);
+	if (fd == -1)
+		return false;
+
+	/* read geometry first to know the mapping size */
+	if (pread (fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != FRAMERING_MAGIC)
+	{
+		close (fd);
+		return false;
+	}
+	return Map (ring, fd, sizeof(FrameRingHeader) + (size_t)header.slotsize*header.numslots);
+}
+
+void FrameRingClose (FrameRing* ring)
+{
+	if (ring->header != NULL)
+		munmap (ring->header, ring->size);
+	if (ring->owner)
+		shm_unlink (ring->name);
+	ring->header = NULL;
+}
+
+static FrameRingSlot* GetSlot (FrameRing* ring, uint32_t sequence)
+{
+	return (FrameRingSlot*)(ring->base + (size_t)(sequence % ring->header->numslots)*ring->header->slotsize);
+}
+
+/* returns the pixels of the next free slot, or NULL if the consumer hasn't released any */
+uint8_t* FrameRingAcquire (FrameRing* ring)
+{
+	FrameRingHeader* header = ring->header;
+	const uint32_t written = header->written;
+
+	if (written - load_acquire (&header->read) >= header->numslots)
+		return NULL;
+	return (uint8_t*)(GetSlot (ring, written) + 1);
+}
+
+/* hands the slot returned by FrameRingAcquire() over to the consumer */
+void FrameRingPublish (FrameRing* ring, int time)
+{
+	FrameRingHeader* header = ring->header;
+	FrameRingSlot* slot = GetSlot (ring, header->written);
+
+	slot->sequence = header->written;
+	slot->time = time;
+	store_release (&header->written, header->written + 1);
+}
+
+/* tells the consumer that no more frames will come */
+void FrameRingFinish (FrameRing* ring)
+{
+	store_release (&ring->header->closed, 1);
+}
+
+/* returns the pixels of the oldest published frame, or NULL if there are none */
+uint8_t* FrameRingPeek (FrameRing* ring, FrameRingSlot** slot)
+{
+	FrameRingHeader* header = ring->header;
+	const uint32_t read = header->read;
+	FrameRingSlot* current;
+
+	if (read == load_acquire (&header->written))
+		return NULL;
+
+	current = GetSlot (ring, read);
+	if (slot != NULL)
+		*slot = current;
+	return (uint8_t*)(current + 1);
+}
+
+/* gives the slot returned by FrameRingPeek() back to the producer */
+void FrameRingRelease (FrameRing* ring)
+{
+	store_release (&ring->header->read, ring->header->read + 1);
+}
+
+/* producer finished and all its frames have been consumed */
+bool FrameRingFinished (FrameRing* ring)
+{
+	FrameRingHeader* header = ring->header;
+	return load_acquire (&header->closed) && header->read == load_acquire (&header->written);
+}
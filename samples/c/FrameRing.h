@@ -0,0 +1,82 @@
+/******************************************************************************
+*
+* Tilengine sample
+* http://www.tilengine.org
+*
+* Ring of frames in POSIX shared memory, to hand rendered frames over to
+* another process (encoder, presenter...) without copying them. The producer
+* renders directly inside the slots with TLN_SetRenderTarget(), and slot
+* ownership is passed with two lock-free sequence counters: one producer and
+* one consumer.
+*
+******************************************************************************/
+
+#ifndef _FRAMERING_H
+#define _FRAMERING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define FRAMERING_MAGIC	0x52474E52	/* "RNGR" */
+#define FRAMERING_ALIGN	64
+
+/* shared header at the start of the mapping */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t width;			/* frame size in pixels */
+	uint32_t height;
+	uint32_t pitch;			/* bytes per scanline */
+	uint32_t numslots;
+	uint32_t slotsize;		/* bytes between slots */
+	volatile uint32_t closed;	/* producer finished */
+	uint8_t  pad1[FRAMERING_ALIGN - 7*sizeof(uint32_t)];
+	volatile uint32_t written;	/* frames published by the producer */
+	uint8_t  pad2[FRAMERING_ALIGN - sizeof(uint32_t)];
+	volatile uint32_t read;		/* frames released by the consumer */
+	uint8_t  pad3[FRAMERING_ALIGN - sizeof(uint32_t)];
+}
+FrameRingHeader;
+
+/* header of each slot, followed by the pixels */
+typedef struct
+{
+	uint32_t sequence;		/* frame number */
+	int32_t  time;			/* timestamp passed to TLN_UpdateFrame() */
+	uint8_t  pad[FRAMERING_ALIGN - 2*sizeof(uint32_t)];
+}
+FrameRingSlot;
+
+typedef struct
+{
+	char name[64];
+	FrameRingHeader* header;
+	uint8_t* base;			/* first slot */
+	size_t size;			/* mapping size */
+	bool owner;				/* created (and unlinked on close) by this process */
+}
+FrameRing;
+
+bool FrameRingCreate (FrameRing* ring, const char* name, int width, int height, int numslots);
+bool FrameRingOpen (FrameRing* ring, const char* name);
+void FrameRingClose (FrameRing* ring);
+
+/* producer */
+uint8_t* FrameRingAcquire (FrameRing* ring);
+void FrameRingPublish (FrameRing* ring, int time);
+void FrameRingFinish (FrameRing* ring);
+
+/* consumer */
+uint8_t* FrameRingPeek (FrameRing* ring, FrameRingSlot** slot);
+void FrameRingRelease (FrameRing* ring);
+bool FrameRingFinished (FrameRing* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+/******************************************************************************
+*
+* Tilengine sample
+* http://www.tilengine.org
+*
+* Records a session of the platformer scene -the per-frame input plus an
+* engine snapshot every few seconds- and then exports it offline, splitting
+* the recording in segments that are rendered at the same time by worker
+* processes. Each worker restores the snapshot at the start of its segment
+* and replays the recorded input from there. The segments are concatenated
+* into a raw RGBA video file.
+*
+* Usage: replay [frames] [-serial]
+*
+******************************************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Tilengine.h"
+
+#define WIDTH		400
+#define HEIGHT		240
+#define SEGMENT		240		/* frames between snapshots */
+#define OUTPUT		"replay.raw"
+
+/* input bits */
+#define KEY_RIGHT	1
+#define KEY_LEFT	2
+
+/* layers */
+enum
+{
+	LAYER_FOREGROUND,
+	LAYER_BACKGROUND,
+	MAX_LAYER
+};
+
+/* application state: must be saved along with the engine snapshot */
+typedef struct
+{
+	float speed;
+	float pos_foreground;
+	float pos_background[6];
+}
+State;
+
+typedef struct
+{
+	TLN_Snapshot snapshot;
+	State state;
+}
+Checkpoint;
+
+static const float inc_background[6] = { 0.562f, 0.437f, 0.375f, 0.625f, 1.0f, 2.0f };
+static State state;
+static uint8_t* framebuffer;
+
+static void raster_callback (int line);
+
+/* game logic for one frame: the only place where input is read */
+static void Update (uint8_t input)
+{
+	int c;
+
+	if (input & KEY_RIGHT)
+	{
+		state.speed += 0.02f;
+		if (state.speed > 1.0f)
+			state.speed = 1.0f;
+	}
+	else if (state.speed > 0.0f)
+	{
+		state.speed -= 0.02f;
+		if (state.speed < 0.0f)
+			state.speed = 0.0f;
+	}
+
+	if (input & KEY_LEFT)
+	{
+		state.speed -= 0.02f;
+		if (state.speed < -1.0f)
+			state.speed = -1.0f;
+	}
+	else if (state.speed < 0.0f)
+	{
+		state.speed += 0.02f;
+		if (state.speed > 0.0f)
+			state.speed = 0.0f;
+	}
+
+	state.pos_foreground += 3.0f*state.speed;
+	TLN_SetLayerPosition (LAYER_FOREGROUND, (int)state.pos_foreground, 48);
+	for (c=0; c<6; c++)
+		state.pos_background[c] += inc_background[c]*state.speed;
+}
+
+/* stands for the player: holds a direction for a random while */
+static uint8_t GetPlayerInput (int frame)
+{
+	static uint32_t seed = 1;
+	static uint8_t input = KEY_RIGHT;
+	static int hold = 0;
+
+	if (hold-- == 0)
+	{
+		seed = seed*1103515245 + 12345;
+		input = (seed >> 16) % 4 == 0 ? KEY_LEFT : KEY_RIGHT;
+		hold = 30 + (seed >> 8) % 120;
+	}
+	return input;
+}
+
+/* renders frames [first, last) replaying the recorded input */
+static void RenderSegment (FILE* file, const uint8_t* inputs, int first, int last)
+{
+	int frame;
+
+	for (frame=first; frame<last; frame++)
+	{
+		Update (inputs[frame]);
+		TLN_UpdateFrame (frame);
+		fwrite (framebuffer, WIDTH*4, HEIGHT, file);
+	}
+}
+
+/* appends a file to another and deletes it */
+static void Append (FILE* dst, const char* filename)
+{
+	static uint8_t buffer[65536];
+	FILE* src = fopen (filename, "rb");
+	size_t size;
+
+	if (src == NULL)
+		return;
+	while ((size = fread (buffer, 1, sizeof(buffer), src)) > 0)
+		fwrite (buffer, 1, size, dst);
+	fclose (src);
+	remove (filename);
+}
+
+int main (int argc, char* argv[])
+{
+	TLN_Tilemap tilemaps[MAX_LAYER];
+	TLN_SequencePack sp;
+	uint8_t* inputs;
+	Checkpoint* checkpoints;
+	FILE* output;
+	int frames = 1200;
+	int numsegments;
+	int running = 0;
+	int workers;
+	bool serial = false;
+	int frame;
+	int c;
+
+	for (c=1; c<argc; c++)
+	{
+		if (!strcmp (argv[c], "-serial"))
+			serial = true;
+		else
+			frames = atoi (argv[c]);
+	}
+
+	/* setup engine */
+	TLN_Init (WIDTH, HEIGHT, MAX_LAYER, 0, 20);
+	framebuffer = malloc (WIDTH*HEIGHT*4);
+	TLN_SetRenderTarget (framebuffer, WIDTH*4);
+	TLN_SetRasterCallback (raster_callback);
+	TLN_SetLoadPath ("../assets/sonic");
+	tilemaps[LAYER_FOREGROUND] = TLN_LoadTilemap ("Sonic_md_fg1.tmx", NULL);
+	tilemaps[LAYER_BACKGROUND] = TLN_LoadTilemap ("Sonic_md_bg1.tmx", NULL);
+	TLN_SetLayer (LAYER_FOREGROUND, NULL, tilemaps[LAYER_FOREGROUND]);
+	TLN_SetLayer (LAYER_BACKGROUND, NULL, tilemaps[LAYER_BACKGROUND]);
+	sp = TLN_LoadSequencePack ("Sonic_md_seq.sqx");
+	TLN_SetPaletteAnimation (TLN_GetAvailableAnimation (), TLN_GetLayerPalette (LAYER_BACKGROUND), TLN_FindSequence (sp, "seq_water"), true);
+
+	numsegments = (frames + SEGMENT - 1)/SEGMENT;
+	inputs = malloc (frames);
+	checkpoints = calloc (numsegments, sizeof(Checkpoint));
+	output = fopen (OUTPUT, "wb");
+
+	if (serial)
+	{
+		/* reference: render the whole session in order */
+		for (frame=0; frame<frames; frame++)
+			inputs[frame] = GetPlayerInput (frame);
+		RenderSegment (output, inputs, 0, frames);
+		printf ("%d frames rendered serially\n", frames);
+	}
+	else
+	{
+		/* recording session: the game runs as usual, recording its input and a checkpoint
+		 * at the start of each segment */
+		for (frame=0; frame<frames; frame++)
+		{
+			if (frame % SEGMENT == 0)
+			{
+				checkpoints[frame/SEGMENT].snapshot = TLN_CreateSnapshot ();
+				checkpoints[frame/SEGMENT].state = state;
+			}
+			inputs[frame] = GetPlayerInput (frame);
+			Update (inputs[frame]);
+			TLN_UpdateFrame (frame);
+		}
+
+		/* export: one worker process per segment, as many at once as processors */
+		workers = (int)sysconf (_SC_NPROCESSORS_ONLN);
+		for (c=0; c<numsegments; c++)
+		{
+			if (running == workers)
+			{
+				wait (NULL);
+				running--;
+			}
+			if (fork () == 0)
+			{
+				char filename[32];
+				FILE* file;
+				int last = (c + 1)*SEGMENT < frames ? (c + 1)*SEGMENT : frames;
+
+				sprintf (filename, "replay_%d.raw", c);
+				file = fopen (filename, "wb");
+				TLN_RestoreSnapshot (checkpoints[c].snapshot);
+				state = checkpoints[c].state;
+				RenderSegment (file, inputs, c*SEGMENT, last);
+				fclose (file);
+				_exit (0);
+			}
+			running++;
+		}
+		while (running--)
+			wait (NULL);
+
+		/* concatenate segments */
+		for (c=0; c<numsegments; c++)
+		{
+			char filename[32];
+			sprintf (filename, "replay_%d.raw", c);
+			Append (output, filename);
+			TLN_DeleteSnapshot (checkpoints[c].snapshot);
+		}
+		printf ("%d frames rendered in %d segments by up to %d workers\n", frames, numsegments, workers);
+	}
+	printf ("Output: %s (%dx%d RGBA)\n", OUTPUT, WIDTH, HEIGHT);
+
+	fclose (output);
+	free (checkpoints);
+	free (inputs);
+	free (framebuffer);
+	TLN_DeleteTilemap (tilemaps[LAYER_FOREGROUND]);
+	TLN_DeleteTilemap (tilemaps[LAYER_BACKGROUND]);
+	TLN_DeleteSequencePack (sp);
+	TLN_Deinit ();
+	return 0;
+}
+
+/* raster callback: background strips with different scroll speeds */
+static void raster_callback (int line)
+{
+	int pos = -1;
+
+	if (line == 0)
+		pos = (int)state.pos_background[0];
+	else if (line == 32)
+		pos = (int)state.pos_background[1];
+	else if (line == 48)
+		pos = (int)state.pos_background[2];
+	else if (line == 64)
+		pos = (int)state.pos_background[3];
+	else if (line == 112)
+		pos = (int)state.pos_background[4];
+	else if (line >= 152)
+		pos = (int)(state.pos_background[4] + (state.pos_background[5] - state.pos_background[4])*(line - 152)/(HEIGHT - 152));
+
+	if (pos != -1)
+		TLN_SetLayerPosition (LAYER_BACKGROUND, pos, 0);
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+*
+* Tilengine sample
+* http://www.tilengine.org
+*
+* Reference consumer for the ring of frames written by RingProducer. Reads
+* each frame in place, prints its checksum and releases the slot. A real
+* consumer would feed the pixels to an encoder or a display instead.
+*
+* Usage: ring_consumer
+*
+******************************************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <unistd.h>
+#include "FrameRing.h"
+
+#define RING_NAME	"/tilengine_frames"
+
+/* FNV-1a hash of the frame */
+static uint32_t Checksum (const uint8_t* pixels, FrameRingHeader* header)
+{
+	uint32_t hash = 2166136261u;
+	uint32_t size = header->pitch*header->height;
+	uint32_t c;
+
+	for (c=0; c<size; c++)
+	{
+		hash ^= pixels[c];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int main (int argc, char* argv[])
+{
+	FrameRing ring;
+	int retries;
+	int frames = 0;
+
+	/* wait for the producer to create the ring */
+	for (retries=0; !FrameRingOpen (&ring, RING_NAME); retries++)
+	{
+		if (retries == 5000)
+		{
+			printf ("Shared memory ring %s not found\n", RING_NAME);
+			return 1;
+		}
+		usleep (1000);
+	}
+
+	while (!FrameRingFinished (&ring))
+	{
+		FrameRingSlot* slot;
+		uint8_t* pixels = FrameRingPeek (&ring, &slot);
+		if (pixels == NULL)
+		{
+			usleep (1000);
+			continue;
+		}
+
+		printf ("frame %u time %d checksum %08X\n", slot->sequence, slot->time, Checksum (pixels, ring.header));
+		FrameRingRelease (&ring);
+		frames++;
+	}
+
+	printf ("%d frames received\n", frames);
+	FrameRingClose (&ring);
+	return 0;
+}
@@ -0,0 +1,75 @@
+/******************************************************************************
+*
+* Tilengine sample
+* http://www.tilengine.org
+*
+* Renders a scrolling scene straight into a ring of frames in shared memory,
+* to be read by another process like RingConsumer. There is no window and no
+* copy: each frame sets the next free slot as render target.
+*
+* Usage: ring_producer [frames]
+*
+******************************************************************************/
+
+#define _XOPEN_SOURCE 500
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "Tilengine.h"
+#include "FrameRing.h"
+
+#define WIDTH		400
+#define HEIGHT		240
+#define NUM_SLOTS	4
+#define RING_NAME	"/tilengine_frames"
+
+int main (int argc, char* argv[])
+{
+	FrameRing ring;
+	TLN_Tilemap foreground;
+	TLN_Tilemap background;
+	int frames = argc > 1 ? atoi (argv[1]) : 600;
+	int frame;
+
+	if (!FrameRingCreate (&ring, RING_NAME, WIDTH, HEIGHT, NUM_SLOTS))
+	{
+		printf ("Cannot create shared memory ring %s\n", RING_NAME);
+		return 1;
+	}
+
+	/* setup engine */
+	TLN_Init (WIDTH, HEIGHT, 2, 0, 1);
+	TLN_SetBGColor (0x1B, 0x00, 0x8B);
+	TLN_SetLoadPath ("../assets/sonic");
+	foreground = TLN_LoadTilemap ("Sonic_md_fg1.tmx", NULL);
+	background = TLN_LoadTilemap ("Sonic_md_bg1.tmx", NULL);
+	TLN_SetLayer (0, NULL, foreground);
+	TLN_SetLayer (1, NULL, background);
+
+	for (frame=0; frame<frames; frame++)
+	{
+		uint8_t* pixels;
+
+		/* wait for the consumer to release a slot */
+		while ((pixels = FrameRingAcquire (&ring)) == NULL)
+			usleep (1000);
+
+		TLN_SetLayerPosition (0, frame*2, 32);
+		TLN_SetLayerPosition (1, frame, 0);
+		TLN_SetRenderTarget (pixels, ring.header->pitch);
+		TLN_UpdateFrame (frame);
+		FrameRingPublish (&ring, frame);
+	}
+	FrameRingFinish (&ring);
+
+	/* keep the ring alive until the consumer is done */
+	while (!FrameRingFinished (&ring))
+		usleep (1000);
+
+	TLN_DeleteTilemap (foreground);
+	TLN_DeleteTilemap (background);
+	TLN_Deinit ();
+	FrameRingClose (&ring);
+	return 0;
+}
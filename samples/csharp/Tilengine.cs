@@ -63,6 +63,8 @@ public enum Error
         WrongFormat,
         WrongSize,
         Unsupported,
+        RefSnapshot,
+        IdxLight,
         MaxError,
     }
 
@@ -140,6 +142,67 @@ public enum Blend
 		Mix = Mix50
     }
 
+    /// <summary>
+    /// Policies of the per-scanline sprite limit for cref="Engine.SetSpriteLimit"
+    /// </summary>
+    public enum SpriteLimit
+    {
+        Drop,
+        Rotate,
+    }
+
+    /// <summary>
+    /// Policies for memory allocations made during frames for cref="Engine.SetStrictAllocation"
+    /// </summary>
+    public enum AllocationPolicy
+    {
+        Allow,
+        Report,
+        Trap,
+    }
+
+    /// <summary>
+    /// Operations of raster programs for cref="Engine.SetRasterProgram"
+    /// </summary>
+    public enum RasterOpcode
+    {
+        End,
+        Push,
+        Line,
+        Time,
+        Table,
+        Dup,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Mod,
+        Min,
+        Max,
+        Sin,
+        Cos,
+        Less,
+        Greater,
+        Select,
+        Skip,
+        LayerX,
+        LayerY,
+        LayerScaling,
+        BgColor,
+        PaletteColor,
+    }
+
+    /// <summary>
+    /// Types of object reported by cref="Engine.GetObjectAt"
+    /// </summary>
+    public enum ObjectType
+    {
+        None,
+        Sprite,
+        Tile,
+        Layer,
+    }
+
     /// <summary>
     /// List of flags for tiles and sprites
     /// </summary>
@@ -270,6 +333,71 @@ public struct PixelMap
 		public ushort dx, dy;
 	}
 
+    /// <summary>
+    /// Input transition returned by cref="Window.GetInputEvent"
+    /// </summary>
+    [StructLayoutAttribute(LayoutKind.Sequential)]
+    public struct InputEvent
+    {
+        public uint Time;       // timestamp in milliseconds, same clock as Window.Ticks
+        public Player Player;   // player the input belongs to
+        public Input Input;     // input that changed
+        [MarshalAsAttribute(UnmanagedType.I1)]
+        public bool Pressed;    // true if pressed, false if released
+    }
+
+    /// <summary>
+    /// Object that drew a pixel, returned by cref="Engine.GetObjectAt"
+    /// </summary>
+    [StructLayoutAttribute(LayoutKind.Sequential)]
+    public struct ObjectInfo
+    {
+        public ObjectType Type; // type of object
+        public int Index;       // sprite index or layer index
+        public int Row;         // row number in the tilemap for tiles
+        public int Col;         // col number in the tilemap for tiles
+    }
+
+    /// <summary>
+    /// scanline interrupt for cref="Engine.SetRasterInterrupts"
+    /// </summary>
+    [StructLayoutAttribute(LayoutKind.Sequential)]
+    public struct RasterInterrupt
+    {
+        public int line;                // scanline that triggers the interrupt
+        public VideoCallback callback;  // function to call, or null to call the raster callback
+    }
+
+    /// <summary>
+    /// operation of a raster program for cref="Engine.SetRasterProgram"
+    /// </summary>
+    [StructLayoutAttribute(LayoutKind.Sequential)]
+    public struct RasterOp
+    {
+        public RasterOpcode opcode; // operation
+        public int param;           // layer index, or number of operations to skip
+        public float value;         // value pushed by RasterOpcode.Push
+
+        public RasterOp(RasterOpcode opcode, int param = 0, float value = 0)
+        {
+            this.opcode = opcode;
+            this.param = param;
+            this.value = value;
+        }
+    }
+
+    /// <summary>
+    /// Rectangular block of tiles inside a tilemap, returned by cref="Tilemap.GetDirtyRects"
+    /// </summary>
+    [StructLayoutAttribute(LayoutKind.Sequential)]
+    public struct TileRect
+    {
+        public int Row;
+        public int Col;
+        public int Rows;
+        public int Cols;
+    }
+
     /// <summary>
     /// Generic Tilengine exception
     /// </summary>
@@ -349,6 +477,14 @@ public struct Engine
         [DllImport("Tilengine")]
         private static extern void TLN_SetRasterCallback(VideoCallback callback);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetRasterInterrupts(RasterInterrupt[] interrupts, int count);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetRasterProgram(RasterOp[] program, int count, float[] table, int tablesize);
+
         [DllImport("Tilengine")]
         private static extern void TLN_SetFrameCallback(VideoCallback callback);
 
@@ -383,6 +519,72 @@ public struct Engine
         [DllImport("Tilengine")]
         private static extern void TLN_SetCustomBlendFunction(BlendFunction function);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetTileCache(int numTiles);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetPreflippedGraphics(bool enable);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetObjectIdBuffer(bool enable);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_GetObjectAt(int x, int y, out ObjectInfo info);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetSpriteDrawOrder(int[] order, int count);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_EnableSpriteSorting(bool enable);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetPremultipliedOutput(bool enable);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetColorMatrix(float[] matrix);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetColorLUT(byte[] lut, int size);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetGlobalFade(byte r, byte g, byte b, byte factor);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetSpriteLimit(int sprites, int pixels, SpriteLimit mode);
+
+        [DllImport("Tilengine")]
+        private static extern int TLN_GetCulledSpriteLines();
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetStrictAllocation(AllocationPolicy policy);
+
+        [DllImport("Tilengine")]
+        private static extern uint TLN_GetFrameAllocations();
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetLightMap(int cellsize, int numlights);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_SetAmbientLight(byte r, byte g, byte b);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetLight(int nlight, int x, int y, int radius, byte r, byte g, byte b);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_DisableLight(int nlight);
+
+        [DllImport("Tilengine")]
+        private static extern void TLN_DisableLightMap();
+
         private Engine (int numLayers, int numSprites, int numAnimations)
         {
             int c;
@@ -524,6 +726,28 @@ public void SetRasterCallback(VideoCallback callback)
             TLN_SetRasterCallback(callback);
         }
 
+        /// <summary>
+        /// Restricts raster processing to a list of scanlines, so the callback isn't called for every line
+        /// </summary>
+        /// <param name="interrupts">Array of interrupts, items with null callback call the raster callback. Set Null to call it on every line again.</param>
+        /// <remarks>Keep a reference to the delegates while the interrupts are active</remarks>
+        public void SetRasterInterrupts(RasterInterrupt[] interrupts)
+        {
+            bool ok = TLN_SetRasterInterrupts(interrupts, interrupts != null ? interrupts.Length : 0);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Sets a program evaluated by the engine on every scanline, for raster effects without callbacks
+        /// </summary>
+        /// <param name="program">Array of operations. Set Null to remove the current program.</param>
+        /// <param name="table">Optional array of values read by RasterOpcode.Table</param>
+        public void SetRasterProgram(RasterOp[] program, float[] table = null)
+        {
+            bool ok = TLN_SetRasterProgram(program, program != null ? program.Length : 0, table, table != null ? table.Length : 0);
+            Engine.ThrowException(ok);
+        }
+
         /// <summary>
         /// Enables user callback for each drawn frame, like a virtual VBLANK interrupt
         /// </summary>
@@ -554,6 +778,198 @@ public void SetCustomBlendFunction(BlendFunction function)
             TLN_SetCustomBlendFunction(function);
         }
 
+        /// <summary>
+        /// Enables a cache of tiles already translated through their palette, so opaque tile lines of
+        /// regular layers are drawn with a plain memory copy
+        /// </summary>
+        /// <param name="numTiles">Number of tile/palette combinations to keep, or 0 to disable the cache</param>
+        public void SetTileCache(int numTiles)
+        {
+            bool ok = TLN_SetTileCache(numTiles);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Enables drawing horizontally flipped tiles and sprites from mirrored copies made on first use,
+        /// so they're read forwards like the unflipped ones at the cost of extra memory
+        /// </summary>
+        /// <param name="enable">true to use mirrored copies, false to draw flipped graphics in reverse order</param>
+        public void SetPreflippedGraphics(bool enable)
+        {
+            TLN_SetPreflippedGraphics(enable);
+        }
+
+        /// <summary>
+        /// Enables recording which sprite, tile or layer draws each pixel of the frame, for picking with GetObjectAt
+        /// </summary>
+        /// <param name="enable">true to record object IDs while drawing, false to disable it and free its memory</param>
+        public void SetObjectIdBuffer(bool enable)
+        {
+            bool ok = TLN_SetObjectIdBuffer(enable);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Gets the object that drew a pixel in the last frame
+        /// </summary>
+        /// <param name="x">Horizontal position inside the framebuffer</param>
+        /// <param name="y">Vertical position inside the framebuffer</param>
+        /// <returns>Object type, sprite or layer index, and tilemap row and column for tiles</returns>
+        public ObjectInfo GetObjectAt(int x, int y)
+        {
+            ObjectInfo info;
+            bool ok = TLN_GetObjectAt(x, y, out info);
+            Engine.ThrowException(ok);
+            return info;
+        }
+
+        /// <summary>
+        /// Sets the order in which sprites are drawn, independent of their indexes
+        /// </summary>
+        /// <param name="order">Sprite indexes from back to front, or null to draw them in index order. Unlisted sprites are drawn after the listed ones</param>
+        public void SetSpriteDrawOrder(int[] order)
+        {
+            bool ok = TLN_SetSpriteDrawOrder(order, order != null ? order.Length : 0);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Enables or disables sorting of sprites by their SortKey at the start of each frame
+        /// </summary>
+        /// <param name="enable">true to sort, false to draw in index order</param>
+        public void EnableSpriteSorting(bool enable)
+        {
+            TLN_EnableSpriteSorting(enable);
+        }
+
+        /// <summary>
+        /// Enables transparent output with premultiplied alpha, for compositing the frame over other content
+        /// </summary>
+        /// <param name="enable">true to leave uncovered pixels transparent, false for opaque output (default)</param>
+        public void SetPremultipliedOutput(bool enable)
+        {
+            TLN_SetPremultipliedOutput(enable);
+        }
+
+        /// <summary>
+        /// Sets a color matrix applied to all palettes when drawing
+        /// </summary>
+        /// <param name="matrix">12 floats with a 3x4 matrix in row major order (offsets in 0-255 range), or null to disable it</param>
+        public void SetColorMatrix(float[] matrix)
+        {
+            TLN_SetColorMatrix(matrix);
+        }
+
+        /// <summary>
+        /// Sets a 3D color lookup table applied to all palettes when drawing
+        /// </summary>
+        /// <param name="lut">size*size*size RGB triplets, red varying fastest, or null to disable it</param>
+        /// <param name="size">Number of entries per axis (2-64)</param>
+        public void SetColorLUT(byte[] lut, int size)
+        {
+            bool ok = TLN_SetColorLUT(lut, size);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Fades all palettes towards a given color when drawing
+        /// </summary>
+        /// <param name="color">Fade color</param>
+        /// <param name="factor">Amount of fade, 0 = disabled, 255 = full fade color</param>
+        public void SetGlobalFade(Color color, byte factor)
+        {
+            TLN_SetGlobalFade(color.R, color.G, color.B, factor);
+        }
+
+        /// <summary>
+        /// Limits the number of sprites drawn on each scanline, like classic sprite hardware
+        /// </summary>
+        /// <param name="sprites">Maximum number of sprites on a scanline, 0 for no limit</param>
+        /// <param name="pixels">Maximum number of sprite pixels on a scanline, 0 for no limit</param>
+        /// <param name="mode">Which sprites are dropped when a scanline is over the limit</param>
+        public void SetSpriteLimit(int sprites, int pixels, SpriteLimit mode)
+        {
+            bool ok = TLN_SetSpriteLimit(sprites, pixels, mode);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Number of sprite lines dropped by the per-scanline limit in the last frame
+        /// </summary>
+        public int CulledSpriteLines
+        {
+            get { return TLN_GetCulledSpriteLines(); }
+        }
+
+        /// <summary>
+        /// Sets what to do when the engine allocates memory during frames, enforced from the next frame on
+        /// </summary>
+        /// <param name="policy">Allow, report or trap allocations</param>
+        public void SetStrictAllocation(AllocationPolicy policy)
+        {
+            TLN_SetStrictAllocation(policy);
+        }
+
+        /// <summary>
+        /// Number of memory allocations made by the engine since the start of the current frame
+        /// </summary>
+        public uint FrameAllocations
+        {
+            get { return TLN_GetFrameAllocations(); }
+        }
+
+        /// <summary>
+        /// Enables a low resolution light map that multiplies the color of the rendered frame
+        /// </summary>
+        /// <param name="cellSize">Size in pixels of the light map cells, power of two between 2 and 64</param>
+        /// <param name="numLights">Number of point lights to allocate</param>
+        public void SetLightMap(int cellSize, int numLights)
+        {
+            bool ok = TLN_SetLightMap(cellSize, numLights);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Sets the light intensity of the areas not reached by any light
+        /// </summary>
+        /// <param name="color">White leaves the colors unchanged, black is total darkness</param>
+        public void SetAmbientLight(Color color)
+        {
+            TLN_SetAmbientLight(color.R, color.G, color.B);
+        }
+
+        /// <summary>
+        /// Places a point light of the light map
+        /// </summary>
+        /// <param name="index">Light index, from 0 to numLights - 1</param>
+        /// <param name="x">Horizontal position of the center, in screen space</param>
+        /// <param name="y">Vertical position of the center, in screen space</param>
+        /// <param name="radius">Distance in pixels where the light fades out completely</param>
+        /// <param name="color">Intensity at the center</param>
+        public void SetLight(int index, int x, int y, int radius, Color color)
+        {
+            bool ok = TLN_SetLight(index, x, y, radius, color.R, color.G, color.B);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Turns off a point light of the light map
+        /// </summary>
+        /// <param name="index">Light index, from 0 to numLights - 1</param>
+        public void DisableLight(int index)
+        {
+            bool ok = TLN_DisableLight(index);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Disables the light map and releases its lights
+        /// </summary>
+        public void DisableLightMap()
+        {
+            TLN_DisableLightMap();
+        }
+
         /// <summary>
         /// Starts active rendering of the current frame
         /// </summary>
@@ -631,6 +1047,10 @@ public struct Window
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_GetInput(Input id);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_GetInputEvent(out InputEvent inputEvent);
+
         [DllImport("Tilengine")]
         private static extern void TLN_EnableInput (Player player, bool enable);
 
@@ -746,6 +1166,16 @@ public bool GetInput(Input id)
             return TLN_GetInput(id);
         }
 
+        /// <summary>
+        /// Gets the oldest pending input transition, in order and with the time it happened
+        /// </summary>
+        /// <param name="inputEvent">Receives the event</param>
+        /// <returns>true if an event was returned, false if there are no more pending events</returns>
+        public bool GetInputEvent(out InputEvent inputEvent)
+        {
+            return TLN_GetInputEvent(out inputEvent);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -901,6 +1331,10 @@ public struct Layer
         [return: MarshalAsAttribute(UnmanagedType.I1)]
 		private static extern bool TLN_SetLayerPixelMapping (int nlayer, PixelMap[] table);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetLayerBlockedLayout(int nlayer, bool enable);
+
         [DllImport("Tilengine")]
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_SetLayerBlendMode(int nlayer, Blend mode, byte factor);
@@ -925,6 +1359,10 @@ public struct Layer
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_DisableLayerMosaic(int nlayer);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetLayerResolution(int nlayer, int xdivisor, int ydivisor, bool smooth);
+
         [DllImport("Tilengine")]
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_ResetLayerMode(int nlayer);
@@ -940,12 +1378,28 @@ public struct Layer
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_GetLayerTile(int nlayer, int x, int y, out TileInfo info);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_RenderLayerToBitmap(int nlayer, int x, int y, int width, int height, IntPtr bitmap, bool smooth);
+
         [DllImport("Tilengine")]
         private static extern int TLN_GetLayerWidth(int nlayer);
 
         [DllImport("Tilengine")]
         private static extern int TLN_GetLayerHeight(int nlayer);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetTextLayer(int nlayer, IntPtr font, int rows, int cols, byte first);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetLayerText(int nlayer, int row, int col, string text);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_ClearLayerText(int nlayer);
+
         /// <summary>
         ///
         /// </summary>
@@ -1013,6 +1467,16 @@ public void SetPixelMapping(PixelMap[] map)
             Engine.ThrowException(ok);
 		}
 
+        /// <summary>
+        /// Samples cache-friendly copies of the tilemap and tiles in affine and pixel mapping modes
+        /// </summary>
+        /// <param name="enable">true to use the blocked copies, false to use the original layout</param>
+        public void SetBlockedLayout(bool enable)
+        {
+            bool ok = TLN_SetLayerBlockedLayout(index, enable);
+            Engine.ThrowException(ok);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -1085,6 +1549,18 @@ public void DisableMosaic()
             Engine.ThrowException(ok);
         }
 
+        /// <summary>
+        /// Draws the layer at reduced resolution, to lower the cost of distant or blurred backgrounds
+        /// </summary>
+        /// <param name="xdivisor">Horizontal resolution divisor: 1 (full resolution), 2 or 4</param>
+        /// <param name="ydivisor">Vertical resolution divisor: 1 (full resolution), 2 or 4</param>
+        /// <param name="smooth">true to interpolate horizontally between sampled pixels, false to repeat them</param>
+        public void SetResolution(int xdivisor, int ydivisor, bool smooth)
+        {
+            bool ok = TLN_SetLayerResolution(index, xdivisor, ydivisor, smooth);
+            Engine.ThrowException(ok);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -1097,6 +1573,21 @@ public void GetTileInfo(int x, int y, out TileInfo info)
             Engine.ThrowException(ok);
         }
 
+        /// <summary>
+        /// Renders a region of the layer into a bitmap, scaled to fill it
+        /// </summary>
+        /// <param name="bitmap">Target bitmap of 8 or 32 bpp</param>
+        /// <param name="x">Left edge of the region, in pixels</param>
+        /// <param name="y">Top edge of the region, in pixels</param>
+        /// <param name="width">Width of the region, or 0 along with height for the whole layer</param>
+        /// <param name="height">Height of the region, or 0 along with width for the whole layer</param>
+        /// <param name="smooth">true to average the covered pixels, false to take the nearest one</param>
+        public void RenderToBitmap(Bitmap bitmap, int x, int y, int width, int height, bool smooth)
+        {
+            bool ok = TLN_RenderLayerToBitmap(index, x, y, width, height, bitmap.ptr, smooth);
+            Engine.ThrowException(ok);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -1151,6 +1642,40 @@ public void Disable()
             bool ok = TLN_DisableLayer(index);
             Engine.ThrowException(ok);
         }
+
+        /// <summary>
+        /// Configures the layer as a text layer that shows characters with a bitmap font
+        /// </summary>
+        /// <param name="font">Tileset with one glyph per tile, in character order</param>
+        /// <param name="rows">Number of text rows</param>
+        /// <param name="cols">Number of text columns</param>
+        /// <param name="first">Character shown by the first tile of the font</param>
+        public void SetupText(Tileset font, int rows, int cols, char first)
+        {
+            bool ok = TLN_SetTextLayer(index, font.ptr, rows, cols, (byte)first);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Writes a string inside a text layer. Only changed characters are updated
+        /// </summary>
+        /// <param name="row">Starting row</param>
+        /// <param name="col">Starting column</param>
+        /// <param name="text">String to write. A newline continues in the next row at the starting column</param>
+        public void SetText(int row, int col, string text)
+        {
+            bool ok = TLN_SetLayerText(index, row, col, text);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Clears all the text inside a text layer
+        /// </summary>
+        public void ClearText()
+        {
+            bool ok = TLN_ClearLayerText(index);
+            Engine.ThrowException(ok);
+        }
     }
 
     /// <summary>
@@ -1214,6 +1739,10 @@ public struct Sprite
         [DllImport("Tilengine")]
         private static extern IntPtr TLN_GetSpritePalette(int nsprite);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetSpriteSortKey(int nsprite, int key);
+
         /// <summary>
         ///
         /// </summary>
@@ -1354,6 +1883,18 @@ public void Disable()
             bool ok = TLN_DisableSprite(index);
             Engine.ThrowException(ok);
         }
+
+        /// <summary>
+        /// Sets the drawing order key used when sprite sorting is enabled, lower keys are drawn first
+        /// </summary>
+        public int SortKey
+        {
+            set
+            {
+                bool ok = TLN_SetSpriteSortKey(index, value);
+                Engine.ThrowException(ok);
+            }
+        }
     }
 
     /// <summary>
@@ -1628,6 +2169,9 @@ public struct Tileset
         [DllImport("Tilengine")]
         private static extern IntPtr TLN_CreateTileset(int numtiles, int width, int height, IntPtr palette, IntPtr sequencepack, TileAttributes[] attributes);
 
+        [DllImport("Tilengine")]
+        private static extern IntPtr TLN_CreateVirtualTileset(string filename, int offset, int numtiles, int width, int height, IntPtr palette, TileAttributes[] attributes, int numresident);
+
         [DllImport("Tilengine")]
         private static extern IntPtr TLN_LoadTileset(string filename);
 
@@ -1683,6 +2227,25 @@ public Tileset(int numTiles, int width, int height, Palette palette, SequencePac
             ptr = retval;
         }
 
+        /// <summary>
+        /// Creates a tileset whose pixels are read from a pack file as they're needed, keeping only some of them in memory
+        /// </summary>
+        /// <param name="filename">Pack file with the tiles one after another, each one as width*height palette indexes</param>
+        /// <param name="offset">Position of the first tile inside the file</param>
+        /// <param name="numTiles">Number of tiles in the pack file</param>
+        /// <param name="width">Width of each tile (power of two)</param>
+        /// <param name="height">Height of each tile (power of two)</param>
+        /// <param name="palette">Palette to assign</param>
+        /// <param name="attributes">Optional array of attributes, one for each tile</param>
+        /// <param name="numResident">Number of tiles kept in memory at a time</param>
+        /// <returns>The virtual tileset</returns>
+        public static Tileset CreateVirtual(string filename, int offset, int numTiles, int width, int height, Palette palette, TileAttributes[] attributes, int numResident)
+        {
+            IntPtr retval = TLN_CreateVirtualTileset(filename, offset, numTiles, width, height, palette.ptr, attributes, numResident);
+            Engine.ThrowException(retval != IntPtr.Zero);
+            return new Tileset(retval);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -1809,6 +2372,29 @@ public struct Tilemap
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_CopyTiles(IntPtr src, int srcrow, int srccol, int rows, int cols, IntPtr dst, int dstrow, int dstcol);
 
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_SetTilemapTiles(IntPtr tilemap, int row, int col, int rows, int cols, Tile[] tiles, int pitch);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_StampTilemapTiles(IntPtr tilemap, int row, int col, int rows, int cols, Tile[] tiles, int pitch);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_FillTilemapTiles(IntPtr tilemap, int row, int col, int rows, int cols, ref Tile tile);
+
+        [DllImport("Tilengine")]
+        private static extern int TLN_GetTilemapDirtyRects(IntPtr tilemap, TileRect[] rects, int maxrects);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_ClearTilemapDirtyRects(IntPtr tilemap);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_RenderTilemapToBitmap(IntPtr tilemap, IntPtr tileset, int x, int y, int width, int height, IntPtr bitmap, bool smooth);
+
         [DllImport("Tilengine")]
         [return: MarshalAsAttribute(UnmanagedType.I1)]
         private static extern bool TLN_DeleteTilemap(IntPtr tilemap);
@@ -1928,6 +2514,103 @@ public void CopyTiles(int srcRow, int srcCol, int rows, int cols, Tilemap dst, i
             Engine.ThrowException(ok);
         }
 
+        /// <summary>
+        /// Sets a rectangular block of tiles in one call
+        /// </summary>
+        /// <param name="row">First row of the block</param>
+        /// <param name="col">First column of the block</param>
+        /// <param name="rows">Number of rows of the block</param>
+        /// <param name="cols">Number of columns of the block</param>
+        /// <param name="tiles">Source tiles, row after row</param>
+        /// <param name="pitch">Number of tiles between the start of consecutive rows in the source array</param>
+        public void SetTiles(int row, int col, int rows, int cols, Tile[] tiles, int pitch)
+        {
+            bool ok = TLN_SetTilemapTiles(ptr, row, col, rows, cols, tiles, pitch);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Sets a rectangular block of tiles, skipping source tiles with index 0
+        /// </summary>
+        /// <param name="row">First row of the block</param>
+        /// <param name="col">First column of the block</param>
+        /// <param name="rows">Number of rows of the block</param>
+        /// <param name="cols">Number of columns of the block</param>
+        /// <param name="tiles">Source tiles, row after row</param>
+        /// <param name="pitch">Number of tiles between the start of consecutive rows in the source array</param>
+        public void StampTiles(int row, int col, int rows, int cols, Tile[] tiles, int pitch)
+        {
+            bool ok = TLN_StampTilemapTiles(ptr, row, col, rows, cols, tiles, pitch);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Fills a rectangular block with the same tile
+        /// </summary>
+        /// <param name="row">First row of the block</param>
+        /// <param name="col">First column of the block</param>
+        /// <param name="rows">Number of rows of the block</param>
+        /// <param name="cols">Number of columns of the block</param>
+        /// <param name="tile">Tile to write</param>
+        public void FillTiles(int row, int col, int rows, int cols, ref Tile tile)
+        {
+            bool ok = TLN_FillTilemapTiles(ptr, row, col, rows, cols, ref tile);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Gets the areas modified since the dirty rectangles were last cleared
+        /// </summary>
+        /// <returns>Array of dirty rectangles</returns>
+        public TileRect[] GetDirtyRects()
+        {
+            int count = TLN_GetTilemapDirtyRects(ptr, null, 0);
+            Engine.ThrowException(count >= 0);
+            TileRect[] rects = new TileRect[count];
+            TLN_GetTilemapDirtyRects(ptr, rects, count);
+            return rects;
+        }
+
+        /// <summary>
+        /// Clears the dirty rectangles after the changes have been processed
+        /// </summary>
+        public void ClearDirtyRects()
+        {
+            bool ok = TLN_ClearTilemapDirtyRects(ptr);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Renders a region of the tilemap into a bitmap, scaled to fill it
+        /// </summary>
+        /// <param name="bitmap">Target bitmap of 8 or 32 bpp</param>
+        /// <param name="x">Left edge of the region, in pixels</param>
+        /// <param name="y">Top edge of the region, in pixels</param>
+        /// <param name="width">Width of the region, or 0 along with height for the whole tilemap</param>
+        /// <param name="height">Height of the region, or 0 along with width for the whole tilemap</param>
+        /// <param name="smooth">true to average the covered pixels, false to take the nearest one</param>
+        public void RenderToBitmap(Bitmap bitmap, int x, int y, int width, int height, bool smooth)
+        {
+            bool ok = TLN_RenderTilemapToBitmap(ptr, IntPtr.Zero, x, y, width, height, bitmap.ptr, smooth);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        /// Renders a region of the tilemap into a bitmap with another tileset, scaled to fill it
+        /// </summary>
+        /// <param name="tileset">Tileset to draw the tilemap with</param>
+        /// <param name="bitmap">Target bitmap of 8 or 32 bpp</param>
+        /// <param name="x">Left edge of the region, in pixels</param>
+        /// <param name="y">Top edge of the region, in pixels</param>
+        /// <param name="width">Width of the region, or 0 along with height for the whole tilemap</param>
+        /// <param name="height">Height of the region, or 0 along with width for the whole tilemap</param>
+        /// <param name="smooth">true to average the covered pixels, false to take the nearest one</param>
+        public void RenderToBitmap(Tileset tileset, Bitmap bitmap, int x, int y, int width, int height, bool smooth)
+        {
+            bool ok = TLN_RenderTilemapToBitmap(ptr, tileset.ptr, x, y, width, height, bitmap.ptr, smooth);
+            Engine.ThrowException(ok);
+        }
+
         /// <summary>
         ///
         /// </summary>
@@ -2452,4 +3135,53 @@ public void Delete()
             ptr = IntPtr.Zero;
         }
     }
+
+    /// <summary>
+    /// Snapshot of the engine state
+    /// </summary>
+    public struct Snapshot
+    {
+        internal IntPtr ptr;
+
+        [DllImport("Tilengine")]
+        private static extern IntPtr TLN_CreateSnapshot();
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_RestoreSnapshot(IntPtr snapshot);
+
+        [DllImport("Tilengine")]
+        [return: MarshalAsAttribute(UnmanagedType.I1)]
+        private static extern bool TLN_DeleteSnapshot(IntPtr snapshot);
+
+        /// <summary>
+        /// Captures the current engine state
+        /// </summary>
+        /// <returns>Snapshot holding the captured state</returns>
+        public static Snapshot Create()
+        {
+            IntPtr retval = TLN_CreateSnapshot();
+            Engine.ThrowException(retval != IntPtr.Zero);
+            return new Snapshot { ptr = retval };
+        }
+
+        /// <summary>
+        /// Restores the engine state captured in the snapshot
+        /// </summary>
+        public void Restore()
+        {
+            bool ok = TLN_RestoreSnapshot(ptr);
+            Engine.ThrowException(ok);
+        }
+
+        /// <summary>
+        ///
+        /// </summary>
+        public void Delete()
+        {
+            bool ok = TLN_DeleteSnapshot(ptr);
+            Engine.ThrowException(ok);
+            ptr = IntPtr.Zero;
+        }
+    }
 }
@@ -78,6 +78,8 @@ class Error:
 	WRONG_FORMAT = 15  # Resource file has invalid format
 	WRONG_SIZE = 16	 # A width or height parameter is invalid
 	UNSUPPORTED = 17  # Unsupported function
+	REF_SNAPSHOT = 18  # Invalid Snapshot reference
+	IDX_LIGHT = 19  # Light index out of range
 
 
 class Blend:
@@ -88,6 +90,35 @@ class Blend:
 	MIX = MIX50
 
 
+class SpriteLimit:
+	"""
+	Policies of the per-scanline sprite limit for :meth:`Engine.set_sprite_limit`
+	"""
+	DROP, ROTATE = range(2)
+
+
+class AllocationPolicy:
+	"""
+	Policies for memory allocations made during frames, for :meth:`Engine.set_strict_allocation`
+	"""
+	ALLOW, REPORT, TRAP = range(3)
+
+
+class RasterOpcode:
+	"""
+	Operations of raster programs for :meth:`Engine.set_raster_program`
+	"""
+	END, PUSH, LINE, TIME, TABLE, DUP, ADD, SUB, MUL, DIV, MOD, MIN, MAX, SIN, COS, LESS, GREATER, SELECT, SKIP, \
+		LAYER_X, LAYER_Y, LAYER_SCALING, BG_COLOR, PALETTE_COLOR = range(24)
+
+
+class ObjectType:
+	"""
+	Types of object reported by :meth:`Engine.get_object_at`
+	"""
+	NONE, SPRITE, TILE, LAYER = range(4)
+
+
 class Input:
 	"""
 	Available inputs to query in :meth:`Window.get_input`
@@ -118,6 +149,18 @@ class TilengineException(Exception):
 
 
 # structures ------------------------------------------------------------------
+class TileRect(Structure):
+	"""
+	Rectangular block of tiles inside a :class:`Tilemap`, returned by :meth:`Tilemap.get_dirty_rects`
+	"""
+	_fields_ = [
+		("row", c_int),
+		("col", c_int),
+		("rows", c_int),
+		("cols", c_int)
+	]
+
+
 class Tile(Structure):
 	"""
 	Tile data contained in each cell of a :class:`Tilemap` object
@@ -242,6 +285,30 @@ class PixelMap(Structure):
 	]
 
 
+class InputEvent(Structure):
+	"""
+	Input transition returned by :meth:`Window.get_input_event`
+	"""
+	_fields_ = [
+		("time", c_uint),
+		("player", c_int),
+		("input", c_int),
+		("pressed", c_bool)
+	]
+
+
+class ObjectInfo(Structure):
+	"""
+	Object that drew a pixel, returned by :meth:`Engine.get_object_at`
+	"""
+	_fields_ = [
+		("type", c_int),
+		("index", c_int),
+		("row", c_int),
+		("col", c_int)
+	]
+
+
 class Color(object):
 	"""
 	Represents a color value in RGB format
@@ -277,6 +344,30 @@ _video_callback_function = CFUNCTYPE(None, c_int)
 _blend_function = CFUNCTYPE(c_ubyte, c_ubyte, c_ubyte)
 
 
+class _RasterInterrupt(Structure):
+	"""
+	Item of the list passed to :meth:`Engine.set_raster_interrupts`
+	"""
+	_fields_ = [
+		("line", c_int),
+		("callback", _video_callback_function)
+	]
+
+
+class RasterOp(Structure):
+	"""
+	Operation of a raster program for :meth:`Engine.set_raster_program`
+	"""
+	_fields_ = [
+		("opcode", c_int),
+		("param", c_int),
+		("value", c_float)
+	]
+
+	def __init__(self, opcode, param=0, value=0.0):
+		Structure.__init__(self, opcode, param, value)
+
+
 # convert string to c_char_p
 def _encode_string(string):
 	if string is not None:
@@ -304,9 +395,15 @@ def _raise_exception(result=False):
 		raise TilengineException(error_string.decode())
 
 
+def _tile_array(tiles):
+	if isinstance(tiles, Array):
+		return tiles
+	return (Tile * len(tiles))(*tiles)
+
+
 # basic management ------------------------------------------------------------
 _tln.TLN_Init.argtypes = [c_int, c_int, c_int, c_int, c_int]
-_tln.TLN_Init.restype = c_bool
+_tln.TLN_Init.restype = c_void_p
 _tln.TLN_GetNumObjects.restype = c_int
 _tln.TLN_GetVersion.restype = c_int
 _tln.TLN_GetUsedMemory.restype = c_int
@@ -317,11 +414,42 @@ _tln.TLN_SetBGBitmap.argtypes = [c_void_p]
 _tln.TLN_SetBGBitmap.restype = c_bool
 _tln.TLN_SetBGPalette.argtypes = [c_void_p]
 _tln.TLN_SetBGPalette.restype = c_bool
+_tln.TLN_SetColorMatrix.argtypes = [POINTER(c_float)]
+_tln.TLN_SetColorLUT.argtypes = [POINTER(c_ubyte), c_int]
+_tln.TLN_SetColorLUT.restype = c_bool
+_tln.TLN_SetGlobalFade.argtypes = [c_ubyte, c_ubyte, c_ubyte, c_ubyte]
 _tln.TLN_SetRenderTarget.argtypes = [c_void_p, c_int]
 _tln.TLN_UpdateFrame.argtypes = [c_int]
 _tln.TLN_BeginFrame.argtypes = [c_int]
 _tln.TLN_DrawNextScanline.restype = c_bool
 _tln.TLN_SetLoadPath.argtypes = [c_char_p]
+_tln.TLN_SetRasterInterrupts.argtypes = [POINTER(_RasterInterrupt), c_int]
+_tln.TLN_SetRasterInterrupts.restype = c_bool
+_tln.TLN_SetRasterProgram.argtypes = [POINTER(RasterOp), c_int, POINTER(c_float), c_int]
+_tln.TLN_SetRasterProgram.restype = c_bool
+_tln.TLN_SetTileCache.argtypes = [c_int]
+_tln.TLN_SetTileCache.restype = c_bool
+_tln.TLN_SetPreflippedGraphics.argtypes = [c_bool]
+_tln.TLN_SetObjectIdBuffer.argtypes = [c_bool]
+_tln.TLN_SetObjectIdBuffer.restype = c_bool
+_tln.TLN_GetObjectAt.argtypes = [c_int, c_int, POINTER(ObjectInfo)]
+_tln.TLN_GetObjectAt.restype = c_bool
+_tln.TLN_SetSpriteDrawOrder.argtypes = [POINTER(c_int), c_int]
+_tln.TLN_SetSpriteDrawOrder.restype = c_bool
+_tln.TLN_EnableSpriteSorting.argtypes = [c_bool]
+_tln.TLN_SetPremultipliedOutput.argtypes = [c_bool]
+_tln.TLN_SetSpriteLimit.argtypes = [c_int, c_int, c_int]
+_tln.TLN_SetSpriteLimit.restype = c_bool
+_tln.TLN_GetCulledSpriteLines.restype = c_int
+_tln.TLN_SetStrictAllocation.argtypes = [c_int]
+_tln.TLN_GetFrameAllocations.restype = c_uint
+_tln.TLN_SetLightMap.argtypes = [c_int, c_int]
+_tln.TLN_SetLightMap.restype = c_bool
+_tln.TLN_SetAmbientLight.argtypes = [c_ubyte, c_ubyte, c_ubyte]
+_tln.TLN_SetLight.argtypes = [c_int, c_int, c_int, c_int, c_ubyte, c_ubyte, c_ubyte]
+_tln.TLN_SetLight.restype = c_bool
+_tln.TLN_DisableLight.argtypes = [c_int]
+_tln.TLN_DisableLight.restype = c_bool
 
 
 class Engine(object):
@@ -339,6 +467,7 @@ class Engine(object):
 		self.animations = tuple([Animation(n) for n in range(num_animations)])
 		self.version = _tln.TLN_GetVersion()
 		self.cb_raster_func = None
+		self.cb_raster_interrupts = None
 		self.cb_blend_func = None
 		self.library = _tln
 
@@ -366,12 +495,12 @@ class Engine(object):
 		global _engine
 		if _engine is not None:
 			return _engine
-		ok = _tln.TLN_Init(width, height, num_layers, num_sprites, num_animations)
-		if ok is True:
+		handle = _tln.TLN_Init(width, height, num_layers, num_sprites, num_animations)
+		if handle is not None:
 			_engine = Engine(num_layers, num_sprites, num_animations)
 			return _engine
 		else:
-			_raise_exception(ok)
+			_raise_exception()
 
 	def __del__(self):
 		self.library.TLN_Deinit()
@@ -450,6 +579,57 @@ class Engine(object):
 			self.cb_raster_func = _video_callback_function(raster_callback)
 		_tln.TLN_SetRasterCallback(self.cb_raster_func)
 
+	def set_raster_interrupts(self, interrupts):
+		"""
+		Restricts raster processing to a list of scanlines, so the callback isn't called for every line
+
+		:param interrupts: list of scanline numbers, or (scanline, callback) tuples. Lines without \
+			a callback call the one set with :meth:`Engine.set_raster_callback`. Set None to call it on every line again.
+
+		Example::
+
+			def water_line(num_scanline):
+			    engine.layers[0].set_palette(water_palette)
+
+			engine.set_raster_interrupts([(160, water_line)])
+		"""
+		if not interrupts:
+			self.cb_raster_interrupts = None
+			ok = _tln.TLN_SetRasterInterrupts(None, 0)
+		else:
+			items = list()
+			for interrupt in interrupts:
+				if type(interrupt) is tuple:
+					items.append(_RasterInterrupt(interrupt[0], _video_callback_function(interrupt[1])))
+				else:
+					items.append(_RasterInterrupt(interrupt, _video_callback_function()))
+			self.cb_raster_interrupts = (_RasterInterrupt * len(items))(*items)
+			ok = _tln.TLN_SetRasterInterrupts(self.cb_raster_interrupts, len(items))
+		_raise_exception(ok)
+
+	def set_raster_program(self, program, table=None):
+		"""
+		Sets a program evaluated by the engine on every scanline, for raster effects without callbacks
+
+		:param program: list of :class:`RasterOp` objects, or (opcode, param, value) tuples. Set None to remove it
+		:param table: optional list of numbers read by :attr:`RasterOpcode.TABLE`
+
+		Example::
+
+			# layer 0 waves horizontally: x = 8*sin(line*4 + time)
+			engine.set_raster_program([
+				(RasterOpcode.LINE,), (RasterOpcode.PUSH, 0, 4), (RasterOpcode.MUL,),
+				(RasterOpcode.TIME,), (RasterOpcode.ADD,), (RasterOpcode.SIN,),
+				(RasterOpcode.PUSH, 0, 8), (RasterOpcode.MUL,), (RasterOpcode.LAYER_X, 0)])
+		"""
+		if not program:
+			ok = _tln.TLN_SetRasterProgram(None, 0, None, 0)
+		else:
+			ops = [op if isinstance(op, RasterOp) else RasterOp(*op) for op in program]
+			values = (c_float * len(table))(*table) if table else None
+			ok = _tln.TLN_SetRasterProgram((RasterOp * len(ops))(*ops), len(ops), values, len(table) if table else 0)
+		_raise_exception(ok)
+
 	def set_frame_callback(self, frame_callback):
 		"""
 		Enables user callback for each drawn frame, like a virtual VBLANK interrupt
@@ -532,6 +712,188 @@ class Engine(object):
 		self.cb_blend_func = _blend_function(blend_function)
 		_tln.TLN_SetCustomBlendFunction(self.cb_blend_func)
 
+	def set_tile_cache(self, num_tiles):
+		"""
+		Enables a cache of tiles already translated through their palette, so opaque tile lines of
+		regular layers are drawn with a plain memory copy
+
+		:param num_tiles: number of tile/palette combinations to keep, or 0 to disable the cache
+		"""
+		ok = _tln.TLN_SetTileCache(num_tiles)
+		_raise_exception(ok)
+
+	def set_preflipped_graphics(self, enable):
+		"""
+		Enables drawing horizontally flipped tiles and sprites from mirrored copies made on first use,
+		so they're read forwards like the unflipped ones at the cost of extra memory
+
+		:param enable: True to use mirrored copies, False to draw flipped graphics in reverse order
+		"""
+		_tln.TLN_SetPreflippedGraphics(enable)
+
+	def set_object_id_buffer(self, enable):
+		"""
+		Enables recording which sprite, tile or layer draws each pixel of the frame, for picking
+		with :meth:`get_object_at`
+
+		:param enable: True to record object IDs while drawing, False to disable it and free its memory
+		"""
+		ok = _tln.TLN_SetObjectIdBuffer(enable)
+		_raise_exception(ok)
+
+	def get_object_at(self, x, y):
+		"""
+		Returns the object that drew a pixel in the last frame
+
+		:param x: horizontal position inside the framebuffer
+		:param y: vertical position inside the framebuffer
+		:return: :class:`ObjectInfo` object with its :class:`ObjectType`, the sprite or layer index, \
+			and the tilemap row and column for tiles
+		"""
+		info = ObjectInfo()
+		ok = _tln.TLN_GetObjectAt(x, y, info)
+		_raise_exception(ok)
+		return info
+
+	def set_sprite_draw_order(self, order):
+		"""
+		Sets the order in which sprites are drawn, independent of their indexes
+
+		:param order: list of sprite indexes from back to front, or None to draw them in index order. \
+			Sprites not listed are drawn after the listed ones
+		"""
+		if order is None:
+			ok = _tln.TLN_SetSpriteDrawOrder(None, 0)
+		else:
+			ok = _tln.TLN_SetSpriteDrawOrder((c_int * len(order))(*order), len(order))
+		_raise_exception(ok)
+
+	def enable_sprite_sorting(self, enable):
+		"""
+		Enables or disables sorting of sprites by their key at the start of each frame
+
+		:param enable: True to sort sprites by the key set with :meth:`Sprite.set_sort_key`, False to draw them in index order
+		"""
+		_tln.TLN_EnableSpriteSorting(enable)
+
+	def set_premultiplied_output(self, enable):
+		"""
+		Enables transparent output with premultiplied alpha, for compositing the frame over other content
+
+		:param enable: True to leave uncovered pixels transparent, False for opaque output (default)
+		"""
+		_tln.TLN_SetPremultipliedOutput(enable)
+
+	def set_color_matrix(self, matrix=None):
+		"""
+		Sets a color matrix applied to all palettes when drawing
+
+		:param matrix: sequence of 12 floats with a 3x4 matrix in row major order (offsets in 0-255 range), or None to disable it
+		"""
+		if matrix is None:
+			_tln.TLN_SetColorMatrix(None)
+		else:
+			_tln.TLN_SetColorMatrix((c_float * 12)(*matrix))
+
+	def set_color_lut(self, lut, size):
+		"""
+		Sets a 3D color lookup table applied to all palettes when drawing
+
+		:param lut: bytes with size*size*size RGB triplets, red varying fastest, or None to disable it
+		:param size: number of entries per axis (2-64)
+		"""
+		if lut is None:
+			ok = _tln.TLN_SetColorLUT(None, 0)
+		else:
+			ok = _tln.TLN_SetColorLUT((c_ubyte * len(lut)).from_buffer_copy(lut), size)
+		_raise_exception(ok)
+
+	def set_global_fade(self, color, factor):
+		"""
+		Fades all palettes towards a given color when drawing
+
+		:param color: :class:`Color` object with the fade color
+		:param factor: amount of fade, 0 = disabled, 255 = full fade color
+		"""
+		_tln.TLN_SetGlobalFade(color.r, color.g, color.b, factor)
+
+	def set_sprite_limit(self, sprites, pixels=0, mode=SpriteLimit.DROP):
+		"""
+		Limits the number of sprites drawn on each scanline, like classic sprite hardware
+
+		:param sprites: maximum number of sprites on a scanline, 0 for no limit
+		:param pixels: maximum number of sprite pixels on a scanline, 0 for no limit
+		:param mode: member of :class:`SpriteLimit` choosing which sprites are dropped
+		"""
+		ok = _tln.TLN_SetSpriteLimit(sprites, pixels, mode)
+		_raise_exception(ok)
+
+	def get_culled_sprite_lines(self):
+		"""
+		:return: number of sprite lines dropped by the per-scanline limit in the last frame
+		"""
+		return _tln.TLN_GetCulledSpriteLines()
+
+	def set_strict_allocation(self, policy):
+		"""
+		Sets what to do when the engine allocates memory during frames, enforced from the next frame on
+
+		:param policy: member of :class:`AllocationPolicy`
+		"""
+		_tln.TLN_SetStrictAllocation(policy)
+
+	def get_frame_allocations(self):
+		"""
+		:return: number of memory allocations made by the engine since the start of the current frame
+		"""
+		return _tln.TLN_GetFrameAllocations()
+
+	def set_light_map(self, cell_size, num_lights):
+		"""
+		Enables a low resolution light map that multiplies the color of the rendered frame
+
+		:param cell_size: size in pixels of the light map cells, power of two between 2 and 64
+		:param num_lights: number of point lights to allocate
+		"""
+		ok = _tln.TLN_SetLightMap(cell_size, num_lights)
+		_raise_exception(ok)
+
+	def set_ambient_light(self, color):
+		"""
+		Sets the light intensity of the areas not reached by any light
+
+		:param color: :class:`Color` object, white leaves the colors unchanged and black is total darkness
+		"""
+		_tln.TLN_SetAmbientLight(color.r, color.g, color.b)
+
+	def set_light(self, index, x, y, radius, color):
+		"""
+		Places a point light of the light map
+
+		:param index: light index, from 0 to num_lights - 1
+		:param x: horizontal position of the center, in screen space
+		:param y: vertical position of the center, in screen space
+		:param radius: distance in pixels where the light fades out completely
+		:param color: :class:`Color` object with the intensity at the center
+		"""
+		ok = _tln.TLN_SetLight(index, x, y, radius, color.r, color.g, color.b)
+		_raise_exception(ok)
+
+	def disable_light(self, index):
+		"""
+		Turns off a point light of the light map
+
+		:param index: light index, from 0 to num_lights - 1
+		"""
+		ok = _tln.TLN_DisableLight(index)
+		_raise_exception(ok)
+
+	def disable_light_map(self):
+		"""
+		Disables the light map and releases its lights
+		"""
+		_tln.TLN_DisableLightMap()
+
 	def get_available_sprite(self):
 		"""
 		:return: Index of the first unused sprite (starting from 0) or -1 if none found
@@ -556,6 +918,8 @@ _tln.TLN_ProcessWindow.restype = c_bool
 _tln.TLN_IsWindowActive.restype = c_bool
 _tln.TLN_GetInput.argtypes = [c_int]
 _tln.TLN_GetInput.restype = c_bool
+_tln.TLN_GetInputEvent.argtypes = [POINTER(InputEvent)]
+_tln.TLN_GetInputEvent.restype = c_bool
 _tln.TLN_EnableInput.argtypes = [c_int, c_bool]
 _tln.TLN_AssignInputJoystick.argtypes = [c_int, c_int]
 _tln.TLN_DefineInputKey.argtypes = [c_int, c_int, c_uint]
@@ -653,6 +1017,26 @@ class Window(object):
 		"""
 		return _tln.TLN_GetInput(input_id)
 
+	def get_input_event(self):
+		"""
+		Returns the oldest pending input transition, in order and with the time it happened,
+		so presses shorter than a frame aren't lost
+
+		:return: :class:`InputEvent` object, or None if there are no more pending events
+
+		Example::
+
+			event = window.get_input_event()
+			while event is not None:
+				if event.pressed and event.input == Input.BUTTON1:
+					fire(event.player, event.time)
+				event = window.get_input_event()
+		"""
+		event = InputEvent()
+		if _tln.TLN_GetInputEvent(event):
+			return event
+		return None
+
 	def enable_input(self, player, state):
 		"""
 		Enables or disables input for specified player
@@ -862,6 +1246,8 @@ class Spriteset(object):
 # tilesets management ---------------------------------------------------------
 _tln.TLN_CreateTileset.argtypes = [c_int, c_int, c_int, c_void_p, c_void_p, POINTER(TileAttributes)]
 _tln.TLN_CreateTileset.restype = c_void_p
+_tln.TLN_CreateVirtualTileset.argtypes = [c_char_p, c_int, c_int, c_int, c_int, c_void_p, POINTER(TileAttributes), c_int]
+_tln.TLN_CreateVirtualTileset.restype = c_void_p
 _tln.TLN_LoadTileset.argtypes = [c_char_p]
 _tln.TLN_LoadTileset.restype = c_void_p
 _tln.TLN_CloneTileset.argtypes = [c_void_p]
@@ -921,6 +1307,28 @@ class Tileset(object):
 		else:
 			_raise_exception()
 
+	@classmethod
+	def create_virtual(cls, filename, offset, num_tiles, width, height, palette, attributes=None, num_resident=1024):
+		"""
+		Static method that creates a Tileset whose pixels are read from a pack file as they're needed,
+		keeping only some of them in memory
+
+		:param filename: pack file with the tiles one after another, each one as width*height palette indexes
+		:param offset: position of the first tile inside the file
+		:param num_tiles: number of tiles in the pack file
+		:param width: Width of each tile (power of two)
+		:param height: Height of each tile (power of two)
+		:param palette: Palette object
+		:param attributes: Optional list of attributes, one element per tile in the tileset
+		:param num_resident: number of tiles kept in memory at a time
+		:return: instance of the created object
+		"""
+		handle = _tln.TLN_CreateVirtualTileset(_encode_string(filename), offset, num_tiles, width, height, palette, attributes, num_resident)
+		if handle is not None:
+			return Tileset(handle)
+		else:
+			_raise_exception()
+
 	@classmethod
 	def fromfile(cls, filename):
 		"""
@@ -993,6 +1401,16 @@ _tln.TLN_SetTilemapTile.argtypes = [c_void_p, c_int, c_int, POINTER(Tile)]
 _tln.TLN_SetTilemapTile.restype = c_bool
 _tln.TLN_CopyTiles.argtypes = [c_void_p, c_int, c_int, c_int, c_int, c_void_p, c_int, c_int]
 _tln.TLN_CopyTiles.restype = c_bool
+_tln.TLN_SetTilemapTiles.argtypes = [c_void_p, c_int, c_int, c_int, c_int, POINTER(Tile), c_int]
+_tln.TLN_SetTilemapTiles.restype = c_bool
+_tln.TLN_StampTilemapTiles.argtypes = [c_void_p, c_int, c_int, c_int, c_int, POINTER(Tile), c_int]
+_tln.TLN_StampTilemapTiles.restype = c_bool
+_tln.TLN_FillTilemapTiles.argtypes = [c_void_p, c_int, c_int, c_int, c_int, POINTER(Tile)]
+_tln.TLN_FillTilemapTiles.restype = c_bool
+_tln.TLN_GetTilemapDirtyRects.argtypes = [c_void_p, POINTER(TileRect), c_int]
+_tln.TLN_GetTilemapDirtyRects.restype = c_int
+_tln.TLN_ClearTilemapDirtyRects.argtypes = [c_void_p]
+_tln.TLN_ClearTilemapDirtyRects.restype = c_bool
 _tln.TLN_DeleteTilemap.argtypes = [c_void_p]
 _tln.TLN_DeleteTilemap.restype = c_bool
 
@@ -1100,6 +1518,82 @@ class Tilemap(object):
 		ok = _tln.TLN_CopyTiles(self, src_row, src_col, num_rows, num_cols, dst_tilemap, dst_row, dst_col)
 		_raise_exception(ok)
 
+	def set_tiles(self, row, col, num_rows, num_cols, tiles, pitch=None):
+		"""
+		Sets a rectangular block of tiles in one call
+
+		:param row: First row of the block
+		:param col: First column of the block
+		:param num_rows: Number of rows of the block
+		:param num_cols: Number of columns of the block
+		:param tiles: list or ctypes array of :class:`Tile` objects, row after row
+		:param pitch: optional number of tiles between the start of consecutive rows, defaults to num_cols
+		"""
+		ok = _tln.TLN_SetTilemapTiles(self, row, col, num_rows, num_cols, _tile_array(tiles), pitch or num_cols)
+		_raise_exception(ok)
+
+	def stamp_tiles(self, row, col, num_rows, num_cols, tiles, pitch=None):
+		"""
+		Sets a rectangular block of tiles, skipping source tiles with index 0
+
+		:param row: First row of the block
+		:param col: First column of the block
+		:param num_rows: Number of rows of the block
+		:param num_cols: Number of columns of the block
+		:param tiles: list or ctypes array of :class:`Tile` objects, row after row
+		:param pitch: optional number of tiles between the start of consecutive rows, defaults to num_cols
+		"""
+		ok = _tln.TLN_StampTilemapTiles(self, row, col, num_rows, num_cols, _tile_array(tiles), pitch or num_cols)
+		_raise_exception(ok)
+
+	def fill_tiles(self, row, col, num_rows, num_cols, tile_info):
+		"""
+		Fills a rectangular block with the same tile
+
+		:param row: First row of the block
+		:param col: First column of the block
+		:param num_rows: Number of rows of the block
+		:param num_cols: Number of columns of the block
+		:param tile_info: :class:`Tile` object to write
+		"""
+		ok = _tln.TLN_FillTilemapTiles(self, row, col, num_rows, num_cols, tile_info)
+		_raise_exception(ok)
+
+	def get_dirty_rects(self):
+		"""
+		Gets the areas modified since the dirty rectangles were last cleared
+
+		:return: list of :class:`TileRect` objects
+		"""
+		count = _tln.TLN_GetTilemapDirtyRects(self, None, 0)
+		if count < 0:
+			_raise_exception()
+		rects = (TileRect * count)()
+		_tln.TLN_GetTilemapDirtyRects(self, rects, count)
+		return list(rects)
+
+	def clear_dirty_rects(self):
+		"""
+		Clears the dirty rectangles after the changes have been processed
+		"""
+		ok = _tln.TLN_ClearTilemapDirtyRects(self)
+		_raise_exception(ok)
+
+	def render_to_bitmap(self, bitmap, x=0, y=0, width=0, height=0, smooth=False, tileset=None):
+		"""
+		Renders a region of the tilemap into a bitmap, scaled to fill it
+
+		:param bitmap: target Bitmap object of 8 or 32 bpp
+		:param x: left edge of the region, in pixels
+		:param y: top edge of the region, in pixels
+		:param width: width of the region in pixels, 0 along with height for the whole tilemap
+		:param height: height of the region in pixels, 0 along with width for the whole tilemap
+		:param smooth: True to average the covered pixels, False to take the nearest one
+		:param tileset: optional Tileset object, by default the Tilemap's own Tileset
+		"""
+		ok = _tln.TLN_RenderTilemapToBitmap(self, tileset, x, y, width, height, bitmap, smooth)
+		_raise_exception(ok)
+
 	def __del__(self):
 		if self.owner:
 			ok = self.library.TLN_DeleteTilemap(self)
@@ -1262,6 +1756,10 @@ _tln.TLN_GetBitmapPalette.argtypes = [c_void_p]
 _tln.TLN_GetBitmapPalette.restype = c_void_p
 _tln.TLN_DeleteBitmap.argtypes = [c_void_p]
 _tln.TLN_DeleteBitmap.restype = c_bool
+_tln.TLN_RenderTilemapToBitmap.argtypes = [c_void_p, c_void_p, c_int, c_int, c_int, c_int, c_void_p, c_bool]
+_tln.TLN_RenderTilemapToBitmap.restype = c_bool
+_tln.TLN_RenderLayerToBitmap.argtypes = [c_int, c_int, c_int, c_int, c_int, c_void_p, c_bool]
+_tln.TLN_RenderLayerToBitmap.restype = c_bool
 
 
 class Bitmap(object):
@@ -1541,6 +2039,8 @@ _tln.TLN_SetLayerTransform.argtypes = [c_int, c_float, c_float, c_float, c_float
 _tln.TLN_SetLayerTransform.restype = c_bool
 _tln.TLN_SetLayerPixelMapping.argtypes = [c_int, POINTER(PixelMap)]
 _tln.TLN_SetLayerPixelMapping.restype = c_bool
+_tln.TLN_SetLayerBlockedLayout.argtypes = [c_int, c_bool]
+_tln.TLN_SetLayerBlockedLayout.restype = c_bool
 _tln.TLN_ResetLayerMode.argtypes = [c_int]
 _tln.TLN_ResetLayerMode.restype = c_bool
 _tln.TLN_SetLayerBitmap.argtypes = [c_int, c_void_p]
@@ -1557,6 +2057,8 @@ _tln.TLN_SetLayerMosaic.argtypes = [c_int, c_int, c_int]
 _tln.TLN_SetLayerMosaic.restype = c_bool
 _tln.TLN_DisableLayerMosaic.argtypes = [c_int]
 _tln.TLN_DisableLayerMosaic.restype = c_bool
+_tln.TLN_SetLayerResolution.argtypes = [c_int, c_int, c_int, c_bool]
+_tln.TLN_SetLayerResolution.restype = c_bool
 _tln.TLN_DisableLayer.argtypes = [c_int]
 _tln.TLN_DisableLayer.restype = c_bool
 _tln.TLN_GetLayerPalette.argtypes = [c_int]
@@ -1567,6 +2069,12 @@ _tln.TLN_GetLayerWidth.argtypes = [c_int]
 _tln.TLN_GetLayerWidth.restype = c_int
 _tln.TLN_GetLayerHeight.argtypes = [c_int]
 _tln.TLN_GetLayerHeight.restype = c_int
+_tln.TLN_SetTextLayer.argtypes = [c_int, c_void_p, c_int, c_int, c_char]
+_tln.TLN_SetTextLayer.restype = c_bool
+_tln.TLN_SetLayerText.argtypes = [c_int, c_int, c_int, c_char_p]
+_tln.TLN_SetLayerText.restype = c_bool
+_tln.TLN_ClearLayerText.argtypes = [c_int]
+_tln.TLN_ClearLayerText.restype = c_bool
 
 
 class Layer(object):
@@ -1661,6 +2169,15 @@ class Layer(object):
 		ok = _tln.TLN_SetLayerPixelMapping(self, pixel_map)
 		_raise_exception(ok)
 
+	def set_blocked_layout(self, enable):
+		"""
+		Samples cache-friendly copies of the tilemap and tiles in affine and pixel mapping modes
+
+		:param enable: True to use the blocked copies, False to use the original layout
+		"""
+		ok = _tln.TLN_SetLayerBlockedLayout(self, enable)
+		_raise_exception(ok)
+
 	def reset_mode(self):
 		"""
 		Disables all special effects: scaling, affine transform and pixel mapping, and returns to default render mode.
@@ -1722,6 +2239,17 @@ class Layer(object):
 		ok = _tln.TLN_DisableLayerMosaic(self)
 		_raise_exception(ok)
 
+	def set_resolution(self, xdivisor, ydivisor, smooth=False):
+		"""
+		Draws the layer at reduced resolution, to lower the cost of distant or blurred backgrounds
+
+		:param xdivisor: horizontal resolution divisor: 1 (full resolution), 2 or 4
+		:param ydivisor: vertical resolution divisor: 1 (full resolution), 2 or 4
+		:param smooth: True to interpolate horizontally between sampled pixels, False to repeat them
+		"""
+		ok = _tln.TLN_SetLayerResolution(self, xdivisor, ydivisor, smooth)
+		_raise_exception(ok)
+
 	def disable(self):
 		"""
 		Disables the layer so it is not drawn
@@ -1752,6 +2280,57 @@ class Layer(object):
 		ok = _tln.TLN_GetLayerTile(self, x, y, tile_info)
 		_raise_exception(ok)
 
+	def render_to_bitmap(self, bitmap, x=0, y=0, width=0, height=0, smooth=False):
+		"""
+		Renders a region of the layer into a bitmap, scaled to fill it. Position, effects and raster
+		effects of the layer are ignored
+
+		:param bitmap: target Bitmap object of 8 or 32 bpp
+		:param x: left edge of the region, in pixels
+		:param y: top edge of the region, in pixels
+		:param width: width of the region in pixels, 0 along with height for the whole layer
+		:param height: height of the region in pixels, 0 along with width for the whole layer
+		:param smooth: True to average the covered pixels, False to take the nearest one
+		"""
+		ok = _tln.TLN_RenderLayerToBitmap(self, x, y, width, height, bitmap, smooth)
+		_raise_exception(ok)
+
+	def setup_text(self, font, rows, cols, first=' '):
+		"""
+		Enables the layer as a text layer that shows characters with a bitmap font
+
+		:param font: Tileset object with one glyph per tile, in character order
+		:param rows: number of text rows
+		:param cols: number of text columns
+		:param first: character shown by the first tile of the font
+		"""
+		ok = _tln.TLN_SetTextLayer(self, font, rows, cols, _encode_string(first))
+		if ok is True:
+			self.width = _tln.TLN_GetLayerWidth(self)
+			self.height = _tln.TLN_GetLayerHeight(self)
+			self.tilemap = None
+			return ok
+		else:
+			_raise_exception()
+
+	def set_text(self, row, col, text):
+		"""
+		Writes a string inside a text layer. Only changed characters are updated
+
+		:param row: starting row
+		:param col: starting column
+		:param text: string to write. A newline continues in the next row at the starting column
+		"""
+		ok = _tln.TLN_SetLayerText(self, row, col, _encode_string(text))
+		_raise_exception(ok)
+
+	def clear_text(self):
+		"""
+		Clears all the text inside a text layer
+		"""
+		ok = _tln.TLN_ClearLayerText(self)
+		_raise_exception(ok)
+
 
 # sprite management -----------------------------------------------------------
 _tln.TLN_ConfigSprite.argtypes = [c_int, c_void_p, c_ushort]
@@ -1783,6 +2362,8 @@ _tln.TLN_DisableSprite.argtypes = [c_int]
 _tln.TLN_DisableSprite.restype = c_bool
 _tln.TLN_GetSpritePalette.argtypes = [c_int]
 _tln.TLN_GetSpritePalette.restype = c_void_p
+_tln.TLN_SetSpriteSortKey.argtypes = [c_int, c_int]
+_tln.TLN_SetSpriteSortKey.restype = c_bool
 
 
 class Sprite(object):
@@ -1936,6 +2517,15 @@ class Sprite(object):
 		else:
 			_raise_exception()
 
+	def set_sort_key(self, key):
+		"""
+		Sets the key used to sort the sprite when sorting is enabled, lower keys are drawn first
+
+		:param key: integer sort key, for example the y coordinate of the base of the sprite
+		"""
+		ok = _tln.TLN_SetSpriteSortKey(self, key)
+		_raise_exception(ok)
+
 
 # animation engine ------------------------------------------------------------
 _tln.TLN_SetPaletteAnimation.argtypes = [c_int, c_void_p, c_void_p, c_bool]
@@ -2032,3 +2622,46 @@ class Animation(object):
 		"""
 		ok = _tln.TLN_DisableAnimation(self)
 		_raise_exception(ok)
+
+
+# snapshots --------------------------------------------------------------------
+_tln.TLN_CreateSnapshot.restype = c_void_p
+_tln.TLN_RestoreSnapshot.argtypes = [c_void_p]
+_tln.TLN_RestoreSnapshot.restype = c_bool
+_tln.TLN_DeleteSnapshot.argtypes = [c_void_p]
+_tln.TLN_DeleteSnapshot.restype = c_bool
+
+
+class Snapshot(object):
+	"""
+	The Snapshot object holds a copy of the engine state to resume rendering from it later
+	"""
+	def __init__(self, handle, owner=True):
+		self._as_parameter_ = handle
+		self.owner = owner
+		self.library = _tln
+
+	@classmethod
+	def create(cls):
+		"""
+		Static method that captures the current engine state
+
+		:return: instance of the created object
+		"""
+		handle = _tln.TLN_CreateSnapshot()
+		if handle is not None:
+			return Snapshot(handle)
+		else:
+			_raise_exception()
+
+	def restore(self):
+		"""
+		Restores the engine state captured in the snapshot
+		"""
+		ok = _tln.TLN_RestoreSnapshot(self)
+		_raise_exception(ok)
+
+	def __del__(self):
+		if self.owner:
+			ok = self.library.TLN_DeleteSnapshot(self)
+			_raise_exception(ok)
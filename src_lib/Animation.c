@@ -22,6 +22,7 @@
  * Animation control
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "Tilengine.h"
 #include "Tilemap.h"
@@ -45,9 +46,47 @@ __inline void blendColors (uint8_t* srcptr0, uint8_t* srcptr1, uint8_t* dstptr,
 }
 
 static void SetAnimation (Animation* animation, TLN_Sequence sequence, animation_t type);
-static void ColorCycle (TLN_Palette srcpalette, TLN_Palette dstpalette, struct Strip* strip);
-static void ColorCycleBlend (TLN_Palette srcpalette, TLN_Palette dstpalette, struct Strip* strip, int t);
+static void ColorCycle (TLN_Palette srcpalette, TLN_Palette dstpalette, const struct Strip* strip, const StripState* state);
+static void ColorCycleBlend (TLN_Palette srcpalette, TLN_Palette dstpalette, const struct Strip* strip, const StripState* state, int t);
 static void ReplaceTiles (TLN_Tilemap tilemap, int srctile, int dsttile);
+static void CopyPaletteColors (TLN_Palette dstpalette, TLN_Palette srcpalette);
+
+/* size of the auxiliary palette of each animation */
+#define AUX_PALETTE_SIZE \
+	(int)((sizeof(struct Palette) + 256*sizeof(uint32_t) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+/* size of the block of each animation: auxiliary palette and color strip states */
+#define AUX_BLOCK_SIZE \
+	(AUX_PALETTE_SIZE + MAX_COLOR_STRIPS*(int)sizeof(StripState))
+
+/* creates the auxiliary palettes and the color strip states of all the animations in a single
+ * block, so starting a palette animation never allocates */
+uint8_t* CreateAnimationPool (Animation* animations, int count)
+{
+	uint8_t* pool;
+	int c;
+
+	if (count <= 0)
+		return NULL;
+
+	pool = calloc (count, AUX_BLOCK_SIZE);
+	if (pool == NULL)
+		return NULL;
+
+	for (c=0; c<count; c++)
+	{
+		uint8_t* block = pool + c*AUX_BLOCK_SIZE;
+		TLN_Palette palette = (TLN_Palette)block;
+		palette->type = OT_PALETTE;
+		palette->size = AUX_PALETTE_SIZE;
+		palette->owner = false;
+		palette->entries = 256;
+		palette->version = NewObjectVersion ();
+		animations[c].srcpalette = palette;
+		animations[c].strips = (StripState*)(block + AUX_PALETTE_SIZE);
+	}
+	return pool;
+}
 
 /* main loop tasks */
 void UpdateAnimations (int time)
@@ -55,7 +94,7 @@ void UpdateAnimations (int time)
 	int c;
 	TLN_Sequence sequence;
 	TLN_SequenceFrame* frames;
-	struct Strip* strips;
+	const struct Strip* strips;
 	
 	for (c=0; c<engine->numanimations; c++)
 	{
@@ -67,23 +106,25 @@ void UpdateAnimations (int time)
 		if (animation->type == TYPE_PALETTE)
 		{
 			int i;
-			strips = (struct Strip*)&sequence->data;
+			strips = (const struct Strip*)&sequence->data;
 			for (i=0; i<sequence->count; i++)
 			{
-				struct Strip* strip = &strips[i];
+				const struct Strip* strip = &strips[i];
+				StripState* state = &animation->strips[i];
+
 				/* next frame */
-				if (time >= strip->timer)
+				if (time >= state->timer)
 				{
-					strip->timer = time + strip->delay;
-					strip->pos = (strip->pos + 1) % strip->count;
-					strip->t0 = time;
+					state->timer = time + strip->delay;
+					state->pos = (state->pos + 1) % strip->count;
+					state->t0 = time;
 					if (!animation->blend)
-						ColorCycle (animation->srcpalette, animation->palette, strip);
+						ColorCycle (animation->srcpalette, animation->palette, strip, state);
 				}
 
 				/* interpolate */
 				if (animation->blend)
-					ColorCycleBlend (animation->srcpalette, animation->palette, strip, time);
+					ColorCycleBlend (animation->srcpalette, animation->palette, strip, state, time);
 			}
 			continue;
 		}
@@ -164,12 +205,14 @@ bool TLN_GetAnimationState (int index)
  * 
  * \param blend
  * true for smooth frame interpolation, false for classic, discrete mode
+ *
+ * \remarks
+ * The playback state is kept by the animation and the sequence isn't modified, so the same
+ * sequence can be shared by any number of animations at the same time
  */
 bool TLN_SetPaletteAnimation (int index, TLN_Palette palette, TLN_Sequence sequence, bool blend)
 {
 	Animation* animation;
-	int c;
-	struct Strip* strips;
 
 	TLN_SetLastError (TLN_ERR_OK);
 	
@@ -188,22 +231,21 @@ bool TLN_SetPaletteAnimation (int index, TLN_Palette palette, TLN_Sequence seque
 	if (!CheckBaseObject (palette, OT_PALETTE) || !CheckBaseObject (sequence, OT_SEQUENCE))
 		return false;
 
+	if (sequence->count > MAX_COLOR_STRIPS)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
 	SetAnimation (animation, sequence, TYPE_PALETTE);
 	animation->palette = palette;
 	animation->blend = blend;
 
 	/* start timers */
-	strips = (struct Strip*)&sequence->data;
-	for (c=0; c<sequence->count; c++)
-	{
-		strips[c].timer = 0;
-		strips[c].t0 = 0;
-	}
+	memset (animation->strips, 0, sequence->count*sizeof(StripState));
 
-	/* create auxiliary palette */
-	if (animation->srcpalette == NULL)
-		animation->srcpalette = TLN_CreatePalette (256);
-	CopyBaseObject (animation->srcpalette, palette);
+	/* auxiliary palette from the pool */
+	CopyPaletteColors (animation->srcpalette, palette);
 
 	return true;
 }
@@ -236,8 +278,8 @@ bool TLN_SetPaletteAnimationSource (int index, TLN_Palette palette)
 		return false;
 
 	animation = &engine->animations[index];
-	CopyBaseObject (animation->srcpalette, palette);
-	CopyBaseObject (animation->palette, palette);
+	CopyPaletteColors (animation->srcpalette, palette);
+	CopyPaletteColors (animation->palette, palette);
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -476,13 +518,13 @@ static void SetAnimation (Animation* animation, TLN_Sequence sequence, animation
 }
 
 /* regular color cycle */
-static void ColorCycle (TLN_Palette srcpalette, TLN_Palette dstpalette, struct Strip* strip)
+static void ColorCycle (TLN_Palette srcpalette, TLN_Palette dstpalette, const struct Strip* strip, const StripState* state)
 {
 	int c;
 	uint32_t* srcptr = (uint32_t*)GetPaletteData (srcpalette, strip->first);
 	uint32_t* dstptr = (uint32_t*)GetPaletteData (dstpalette, strip->first);
 	int count = strip->count;
-	int steps = strip->pos;
+	int steps = state->pos;
 
 	if (strip->dir)
 	{
@@ -494,19 +536,29 @@ static void ColorCycle (TLN_Palette srcpalette, TLN_Palette dstpalette, struct S
 		for (c=0; c<count; c++)
 			dstptr[c] = srcptr[(c + steps) % count];
 	}
+	dstpalette->version = NewObjectVersion ();
+}
+
+/* copies the colors of a palette, keeping the header and size of the target */
+static void CopyPaletteColors (TLN_Palette dstpalette, TLN_Palette srcpalette)
+{
+	const int entries = srcpalette->entries < dstpalette->entries? srcpalette->entries : dstpalette->entries;
+
+	memcpy (dstpalette->data, srcpalette->data, entries*sizeof(uint32_t));
+	dstpalette->version = NewObjectVersion ();
 }
 
 /* blended color cycle */
-static void ColorCycleBlend (TLN_Palette srcpalette, TLN_Palette dstpalette, struct Strip* strip, int t)
+static void ColorCycleBlend (TLN_Palette srcpalette, TLN_Palette dstpalette, const struct Strip* strip, const StripState* state, int t)
 {
 	int c;
 	int idx0, idx1;
 	uint8_t *srcptr0, *srcptr1, *dstptr;
 
-	int t0 = strip->t0;
-	int t1 = strip->timer;
+	int t0 = state->t0;
+	int t1 = state->timer;
 	int count = strip->count;
-	int steps = strip->pos;
+	int steps = state->pos;
 
 	/* map [t0 - t1] to [0 - 255] */
 	int f1 = lerp (t, t0,t1, 0,255);
@@ -530,6 +582,7 @@ static void ColorCycleBlend (TLN_Palette srcpalette, TLN_Palette dstpalette, str
 		dstptr  = GetPaletteData (dstpalette, strip->first + c);
 		blendColors (srcptr0, srcptr1, dstptr, f0, f1);
 	}
+	dstpalette->version = NewObjectVersion ();
 }
 
 /* tile substitution */
@@ -538,9 +591,14 @@ static void ReplaceTiles (TLN_Tilemap tilemap, int srctile, int dsttile)
 	int c;
 	int size = tilemap->rows * tilemap->cols;
 
-	for (c=0; c<tilemap->size; c++)
+	for (c=0; c<size; c++)
 	{
 		if (tilemap->tiles[c].index == srctile)
 			tilemap->tiles[c].index = dsttile;
 	}
+
+	/* empty tiles involved: occupancy changes */
+	if (srctile == 0 || dsttile == 0)
+		UpdateTilemapOccupancy (tilemap);
+	AddTilemapDirtyRect (tilemap, 0, 0, tilemap->rows, tilemap->cols);
 }
@@ -23,8 +23,6 @@
 #include "Tilengine.h"
 #include "Sequence.h"
 
-#define MAX_COLOR_STRIPS	32
-
 typedef enum
 {
 	TYPE_NONE,
@@ -35,6 +33,15 @@ typedef enum
 }
 animation_t;
 
+/* playback state of a color strip, kept by the animation so sequences can be shared */
+typedef struct
+{
+	int timer;	/* time of the next step */
+	int t0;		/* time of the last step */
+	int pos;
+}
+StripState;
+
 /* animacin */
 typedef struct
 {
@@ -49,9 +56,11 @@ typedef struct
 	bool blend;
 	TLN_Palette palette;
 	TLN_Palette srcpalette;
+	StripState* strips;	/* MAX_COLOR_STRIPS states for color cycles */
 }
 Animation;
 
 void UpdateAnimations (int time);
+uint8_t* CreateAnimationPool (Animation* animations, int count);
 
 #endif
@@ -117,7 +117,10 @@ bool TLN_DeleteBitmap (TLN_Bitmap bitmap)
 	if (CheckBaseObject (bitmap, OT_BITMAP))
 	{
 		if (ObjectOwner (bitmap))
+		{
+			DeleteGradedPalette (bitmap->palette);
 			DeleteBaseObject (bitmap->palette);
+		}
 		DeleteBaseObject (bitmap);
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
@@ -17,6 +17,7 @@
 * License along with this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
 #include "Tilengine.h"
 #include "Palette.h"
 #include "Blitters.h"
@@ -117,6 +118,7 @@ static void blitFastBlend_8_32 (uint8_t *srcpixel, TLN_Palette palette, void* ds
 		dst[0] = blendfunc(blend, src[0], dst[0]);
 		dst[1] = blendfunc(blend, src[1], dst[1]);
 		dst[2] = blendfunc(blend, src[2], dst[2]);
+		dst[3] = blendalpha(blend, dst[3]);
 		srcpixel += dx;
 		dst += sizeof(uint32_t);
 		width--;
@@ -148,6 +150,7 @@ static void blitFastBlendScaling_8_32 (uint8_t *srcpixel, TLN_Palette palette, v
 		dst[0] = blendfunc(blend, src[0], dst[0]);
 		dst[1] = blendfunc(blend, src[1], dst[1]);
 		dst[2] = blendfunc(blend, src[2], dst[2]);
+		dst[3] = blendalpha(blend, dst[3]);
 		offset += dx;
 		dst += sizeof(uint32_t);
 		width--;
@@ -181,6 +184,7 @@ static void blitKeyBlend_8_32 (uint8_t *srcpixel, TLN_Palette palette, void* dst
 			dst[0] = blendfunc(blend, src[0], dst[0]);
 			dst[1] = blendfunc(blend, src[1], dst[1]);
 			dst[2] = blendfunc(blend, src[2], dst[2]);
+			dst[3] = blendalpha(blend, dst[3]);
 		}
 		srcpixel += dx;
 		dst += sizeof(uint32_t);
@@ -218,6 +222,7 @@ static void blitKeyBlendScaling_8_32 (uint8_t *srcpixel, TLN_Palette palette, vo
 			dst[0] = blendfunc(blend, src[0], dst[0]);
 			dst[1] = blendfunc(blend, src[1], dst[1]);
 			dst[2] = blendfunc(blend, src[2], dst[2]);
+			dst[3] = blendalpha(blend, dst[3]);
 		}
 		offset += dx;
 		dst += sizeof(uint32_t);
@@ -305,6 +310,7 @@ void BlitMosaicBlend (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int
 				dstpixel[0] = blendfunc(blend, value[0], dstpixel[0]);
 				dstpixel[1] = blendfunc(blend, value[1], dstpixel[1]);
 				dstpixel[2] = blendfunc(blend, value[2], dstpixel[2]);
+				dstpixel[3] = blendalpha(blend, dstpixel[3]);
 				dstpixel += sizeof(uint32_t);
 			}
 		}
@@ -314,3 +320,139 @@ void BlitMosaicBlend (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int
 		width -= size;
 	}
 }
+
+/* interpolates two colors, t in 0-256 */
+static uint32_t lerp_color (uint32_t a, uint32_t b, int t)
+{
+	const uint32_t rb = (((a & 0xFF00FF)*(256 - t) + (b & 0xFF00FF)*t) >> 8) & 0xFF00FF;
+	const uint32_t ga = ((((a >> 8) & 0xFF00FF)*(256 - t) + ((b >> 8) & 0xFF00FF)*t) >> 8) & 0xFF00FF;
+	return rb | (ga << 8);
+}
+
+/* writes a color, blended if there's a blend table */
+static void put_color (uint32_t* dstpixel, uint32_t value, uint8_t* blend)
+{
+	if (blend != NULL)
+	{
+		const uint8_t* src = (uint8_t*)&value;
+		uint8_t* dst = (uint8_t*)dstpixel;
+		dst[0] = blendfunc(blend, src[0], dst[0]);
+		dst[1] = blendfunc(blend, src[1], dst[1]);
+		dst[2] = blendfunc(blend, src[2], dst[2]);
+		dst[3] = blendalpha(blend, dst[3]);
+	}
+	else
+		*dstpixel = value;
+}
+
+/* expands a line of palette indexes sampled every size pixels to 32 bpp, the first sample starting
+ * skip pixels before dstptr. Pixels of transparent samples are undefined, BlitExpanded skips them.
+ * With smooth, pixels between two opaque samples are interpolated */
+void BlitExpand (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int width, int size, int skip, bool smooth)
+{
+	uint32_t* dstpixel = (uint32_t*)dstptr;
+	uint32_t* color = (uint32_t*)palette->data;
+
+	/* fast path: plain repetition, aligned part unrolled by size */
+	if (!smooth)
+	{
+		const uint32_t* end;
+		while (skip && width)
+		{
+			*dstpixel++ = color[*srcpixel];
+			width--;
+			if (++skip == size)
+			{
+				srcpixel++;
+				skip = 0;
+			}
+		}
+		end = dstpixel + width - (width % size);
+		if (size == 2)
+		{
+			while (dstpixel < end)
+			{
+				dstpixel[0] = dstpixel[1] = color[*srcpixel++];
+				dstpixel += 2;
+			}
+		}
+		else if (size == 4)
+		{
+			while (dstpixel < end)
+			{
+				dstpixel[0] = dstpixel[1] = dstpixel[2] = dstpixel[3] = color[*srcpixel++];
+				dstpixel += 4;
+			}
+		}
+		else
+		{
+			while (dstpixel < end)
+				*dstpixel++ = color[*srcpixel++];
+		}
+		for (width %= size; width; width--)
+			*dstpixel++ = color[*srcpixel];
+		return;
+	}
+
+	while (width)
+	{
+		int count = size - skip;
+		int c;
+		if (count > width)
+			count = width;
+
+		if (*srcpixel)
+		{
+			const uint32_t value = color[*srcpixel];
+			if (smooth && srcpixel[1])
+			{
+				const uint32_t next = color[srcpixel[1]];
+				for (c=0; c<count; c++)
+					dstpixel[c] = lerp_color (value, next, ((skip + c) << 8)/size);
+			}
+			else
+			{
+				for (c=0; c<count; c++)
+					dstpixel[c] = value;
+			}
+		}
+		dstpixel += count;
+		srcpixel++;
+		width -= count;
+		skip = 0;
+	}
+}
+
+/* copies a line expanded with BlitExpand, skipping the pixels of transparent samples. Runs of
+ * opaque samples are copied at once */
+void BlitExpanded (uint8_t *srcpixel, uint32_t* color, void* dstptr, int width, int size, int skip, uint8_t* blend)
+{
+	uint32_t* dstpixel = (uint32_t*)dstptr;
+	while (width)
+	{
+		const bool opaque = *srcpixel != 0;
+		int count = size - skip;
+		int c;
+
+		srcpixel++;
+		while (count < width && (*srcpixel != 0) == opaque)
+		{
+			count += size;
+			srcpixel++;
+		}
+		if (count > width)
+			count = width;
+
+		if (opaque && blend != NULL)
+		{
+			for (c=0; c<count; c++)
+				put_color (dstpixel + c, color[c], blend);
+		}
+		else if (opaque)
+			memcpy (dstpixel, color, count * sizeof(uint32_t));
+		dstpixel += count;
+		color += count;
+		width -= count;
+		skip = 0;
+	}
+}
@@ -30,5 +30,7 @@ ScanBlitPtr GetBlitter (int bpp, bool key, bool scaling, bool blend);
 void BlitColor (void* dstptr, uint32_t color, int width);
 void BlitMosaicSolid (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int width, int size);
 void BlitMosaicBlend (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int width, int size, uint8_t* blend);
+void BlitExpand (uint8_t *srcpixel, TLN_Palette palette, void* dstptr, int width, int size, int skip, bool smooth);
+void BlitExpanded (uint8_t *srcpixel, uint32_t* color, void* dstptr, int width, int size, int skip, uint8_t* blend);
 
 #endif
\ No newline at end of file
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "Tilengine.h"
 #include "Draw.h"
 #include "Engine.h"
@@ -26,8 +27,13 @@
 #include "Tilemap.h"
 
 /* private prototypes */
+static int SelectLineSprites (int line);
 static void DrawSpriteCollision (int nsprite, uint8_t *srcpixel, uint16_t *dstpixel, int width, int dx);
 static void DrawSpriteCollisionScaling (int nsprite, uint8_t *srcpixel, uint16_t *dstpixel, int width, int dx, int srcx);
+static void DrawObjectIds (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int dx);
+static void DrawObjectIdsScaling (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int dx, int srcx);
+static void DrawObjectIdsExpanded (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int size, int skip);
+static void DrawObjectIdsMosaic (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int size);
 
 /*!
  * \brief Draws the next scanline of the frame started with TLN_BeginFrame() or TLN_BeginWindowFrame()
@@ -40,31 +46,71 @@ bool TLN_DrawNextScanline (void)
 	int line = engine->line;
 	uint8_t* scan = engine->framebuffer.data + line*engine->framebuffer.pitch;
 	int size = engine->framebuffer.width;
+	const int* sprites = engine->order.list;
+	int numsprites = engine->numsprites;
 	int c;
 	bool background_priority = false;
 	bool sprite_priority = false;
 
-	/* call raster effect callback */
-	if (engine->raster)
+	/* raster program */
+	if (engine->program.count)
+		RunRasterProgram (line);
+
+	/* call raster effect callback: only at registered lines if there are interrupts */
+	if (engine->interrupts.count)
+	{
+		while (engine->interrupts.next < engine->interrupts.count)
+		{
+			const TLN_RasterInterrupt* interrupt = &engine->interrupts.list[engine->interrupts.next];
+			if (interrupt->line > line)
+				break;
+			engine->interrupts.next++;
+			if (interrupt->line < line)
+				continue;
+			if (interrupt->callback)
+				interrupt->callback (line);
+			else if (engine->raster)
+				engine->raster (line);
+		}
+	}
+	else if (engine->raster)
 		engine->raster (line);
 
+	/* sprites modified by the raster effects */
+	if (engine->spritedirty.count)
+		UpdateDirtySprites ();
+
 	/* background is bitmap */
 	if (engine->bgbitmap && engine->bgpalette)
 	{
 		if (size > engine->bgbitmap->width)
 			size = engine->bgbitmap->width;
 		if (line < engine->bgbitmap->height)
-			engine->blit_fast (TLN_GetBitmapPtr (engine->bgbitmap, 0,line), engine->bgpalette, scan, size, 1, 0, NULL);
+			engine->blit_fast (TLN_GetBitmapPtr (engine->bgbitmap, 0,line), GetDrawPalette (engine->bgpalette), scan, size, 1, 0, NULL);
 	}
 	
+	/* background is transparent, for compositing */
+	else if (engine->premultiplied)
+		BlitColor (scan, 0, size);
+
 	/* background is solid color */
 	else if (engine->bgcolor)
-		BlitColor (scan, engine->bgcolor, size);
+		BlitColor (scan, engine->grading.enabled? GetGradedColor (engine->bgcolor) : engine->bgcolor, size);
 
 	background_priority = false;
 	memset (engine->priority, 0, engine->framebuffer.pitch);
 	memset (engine->collision, -1, engine->framebuffer.width * sizeof(uint16_t));
 
+	/* object IDs of this line */
+	if (engine->ids.buffer != NULL)
+	{
+		engine->ids.line = engine->ids.buffer + line*engine->framebuffer.width;
+		memset (engine->ids.line, 0, engine->framebuffer.width * sizeof(uint32_t));
+		memset (engine->ids.priority, 0, engine->framebuffer.width * sizeof(uint32_t));
+	}
+	else
+		engine->ids.line = NULL;
+
 	/* draw background layers */
 	for (c=engine->numlayers-1; c>=0; c--)
 	{
@@ -76,14 +122,22 @@ bool TLN_DrawNextScanline (void)
 		}
 	}
 
+	/* sprites on this line within the limit, if there's one */
+	if (engine->spritelimit.sprites || engine->spritelimit.pixels)
+	{
+		sprites = engine->spritelimit.list;
+		numsprites = SelectLineSprites (line);
+	}
+
 	/* draw regular sprites */
-	for (c=0; c<engine->numsprites; c++)
+	for (c=0; c<numsprites; c++)
 	{
-		Sprite* sprite = &engine->sprites[c];
-		if (sprite->ok)
+		const int nsprite = sprites[c];
+		const SpriteScan* scan = &engine->spritescan[nsprite];
+		if (scan->draw && line >= scan->y1 && line < scan->y2)
 		{
-			if (!(sprite->flags & FLAG_PRIORITY))
-				engine->sprites[c].draw (c,line);
+			if (!scan->priority)
+				scan->draw (nsprite,line);
 			else
 				sprite_priority = true;
 		}
@@ -101,28 +155,107 @@ bool TLN_DrawNextScanline (void)
 			src++;
 			dst++;
 		}
+		if (engine->ids.line != NULL)
+		{
+			src = (uint32_t*)engine->priority;
+			for (c=0; c<engine->framebuffer.width; c++)
+			{
+				if (src[c] && engine->ids.priority[c])
+					engine->ids.line[c] = engine->ids.priority[c];
+			}
+		}
 	}
 
 	/* draw sprites with priority */
 	if (sprite_priority == true)
 	{
-		for (c=0; c<engine->numsprites; c++)
+		for (c=0; c<numsprites; c++)
 		{
-			Sprite* sprite = &engine->sprites[c];
-			if (sprite->ok && (sprite->flags & FLAG_PRIORITY))
-				engine->sprites[c].draw (c,line);
+			const int nsprite = sprites[c];
+			const SpriteScan* scan = &engine->spritescan[nsprite];
+			if (scan->draw && scan->priority && line >= scan->y1 && line < scan->y2)
+				scan->draw (nsprite,line);
 		}
 	}
 
+	/* lighting over the finished line */
+	if (engine->lightmap.enabled)
+		ApplyLightMap (line, (uint32_t*)scan);
+
 	/* next scanline */
 	engine->line++;
 	return engine->line < engine->framebuffer.height;
 }
 
+/* fills the list of sprites to draw on a line in drawing order, dropping the ones over the
+ * limit, and returns how many */
+static int SelectLineSprites (int line)
+{
+	const int* order = engine->order.list;
+	int* list = engine->spritelimit.list;
+	const int maxsprites = engine->spritelimit.sprites ? engine->spritelimit.sprites : engine->numsprites;
+	const int maxpixels = engine->spritelimit.pixels ? engine->spritelimit.pixels : INT_MAX;
+	int count = 0;
+	int pixels = 0;
+	int kept = 0;
+	int first, step;
+	int c, n;
+
+	/* candidates */
+	for (c=0; c<engine->numsprites; c++)
+	{
+		const int nsprite = order[c];
+		const SpriteScan* scan = &engine->spritescan[nsprite];
+		if (scan->draw && line >= scan->y1 && line < scan->y2)
+		{
+			list[count++] = nsprite;
+			pixels += scan->width;
+		}
+	}
+	if (count <= maxsprites && pixels <= maxpixels)
+		return count;
+
+	/* from a position that changes each frame, or backwards from the front sprite */
+	if (engine->spritelimit.mode == SPRITE_LIMIT_ROTATE)
+	{
+		first = engine->spritelimit.phase % count;
+		step = 1;
+	}
+	else
+	{
+		first = count - 1;
+		step = count - 1;	/* -1 modulo count */
+	}
+
+	/* keep the sprites that fit, marking the rest */
+	pixels = 0;
+	for (c=0, n=first; c<count; c++, n=(n + step) % count)
+	{
+		const int width = engine->spritescan[list[n]].width;
+		if (kept < maxsprites && pixels + width <= maxpixels)
+		{
+			kept++;
+			pixels += width;
+		}
+		else
+			list[n] = -1;
+	}
+	engine->spritelimit.culled += count - kept;
+
+	/* compact in drawing order */
+	for (c=0, n=0; c<count; c++)
+	{
+		if (list[c] != -1)
+			list[n++] = list[c];
+	}
+	return kept;
+}
+
 /* draw scanline of tiled background */
 static bool DrawLayerScanline (int nlayer, int nscan)
 {
 	const Layer *layer = &engine->layers[nlayer];
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	const TLN_Tileset tileset = layer->tileset;
 	const TLN_Tilemap tilemap = layer->tilemap;
 	int shift;
@@ -138,6 +271,8 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 	uint8_t *dstpixel;
 	uint8_t *dstpixel_pri;
 	uint8_t *dst;
+	uint32_t *ids = NULL;
+	uint32_t *ids_pri = engine->ids.priority;
 	bool color_key;
 	bool priority = false;
 
@@ -155,6 +290,8 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 	{
 		shift = 2;
 		dstpixel = GetFramebufferLine (nscan);
+		if (engine->ids.line != NULL)
+			ids = engine->ids.line + layer->clip.x1;
 	}
 
 	/* target lines */
@@ -166,6 +303,14 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 	xtile = xpos >> tileset->hshift;
 	srcx  = xpos & tileset->hmask;
 
+	/* without column offset the whole scanline maps to a single row: skip if empty */
+	if (!layer->column)
+	{
+		ypos = (layer->vstart + nscan) % layer->height;
+		if (tilemap->rowcount[ypos >> tileset->vshift] == 0)
+			goto draw_end;
+	}
+
 	/* fill whole scanline */
 	column = x % tileset->width;
 	while (x < layer->clip.x2)
@@ -197,8 +342,13 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 		/* paint if not empty tile */
 		if (tile->index)
 		{
-			/* H/V flip */
-			if (tile->flags & FLAG_FLIPX)
+			const int index = GetResidentTile (tileset, tile->index);
+			uint8_t* flipped = NULL;
+
+			/* H/V flip: mirrored copy read forwards, or backwards read */
+			if ((tile->flags & FLAG_FLIPX) && engine->preflip)
+				flipped = GetFlippedTile (tileset, index);
+			if ((tile->flags & FLAG_FLIPX) && !flipped)
 			{
 				direction = -1;
 				srcx = tilewidth - 1;
@@ -209,8 +359,11 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 				srcy = tileset->height - srcy - 1;
 
 			/* paint tile scanline */
-			srcpixel = &GetTilesetPixel (tileset, tile->index, srcx, srcy);
-			if (tile->flags & FLAG_PRIORITY)
+			if (flipped)
+				srcpixel = flipped + (srcy << tileset->hshift) + srcx;
+			else
+				srcpixel = &GetTilesetPixel (tileset, index, srcx, srcy);
+			if ((tile->flags & FLAG_PRIORITY) || tileset->attributes[tile->index - 1].priority)
 			{
 				dst = dstpixel_pri;
 				priority = true;
@@ -219,12 +372,43 @@ static bool DrawLayerScanline (int nlayer, int nscan)
 			{
 				dst = dstpixel;
 			}
-			line = GetTilesetLine (tileset, tile->index, srcy);
+			line = GetTilesetLine (tileset, index, srcy);
 			color_key = *(tileset->color_key + line);
-			layer->blitters[color_key] (srcpixel, layer->palette, dst, width, direction, 0, layer->blend);
+
+			/* opaque line of a cached tile: plain copy */
+			if (engine->tilecache && !color_key && !(tile->flags & FLAG_FLIPX) && shift == 2 && layer->blend == NULL)
+			{
+				uint32_t* srcline = GetTileCacheLine (engine->tilecache, tileset, tile->index, palette, srcy);
+				if (srcline)
+					memcpy (dst, srcline + srcx, width * sizeof(uint32_t));
+				else
+					layer->blitters[color_key] (srcpixel, palette, dst, width, direction, 0, layer->blend);
+			}
+			else
+				layer->blitters[color_key] (srcpixel, palette, dst, width, direction, 0, layer->blend);
+
+			if (ids != NULL)
+				DrawObjectIds (OBJECT_ID_TILE(nlayer, ytile*tilemap->cols + xtile), srcpixel, dst == dstpixel ? ids : ids_pri, width, direction);
+		}
+
+		/* empty tile without column offset: jump over the whole empty run */
+		else if (!layer->column)
+		{
+			int count = GetTilemapEmptyRun (tilemap, ytile, xtile);
+			x1 = x + tilewidth + (count - 1)*tileset->width;
+			if (x1 > layer->clip.x2)
+				x1 = layer->clip.x2;
+			width = x1 - x;
+			xtile = (xtile + count - 1) % tilemap->cols;
+			column += count - 1;
 		}
 
 		/* next tile */
+		if (ids != NULL)
+		{
+			ids += width;
+			ids_pri += width;
+		}
 		x += width;
 		width <<= shift;
 		dstpixel += width;
@@ -243,18 +427,168 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend (srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend (srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid (srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid (srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic (OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 
 	return priority;
 }
 
+/* draw scanline of tiled background at reduced resolution: one pixel of every lowres.x is sampled
+ * into a line of palette indexes, expanded to full resolution and reused for lowres.y lines */
+static bool DrawLayerScanlineLowres (int nlayer, int nscan)
+{
+	Layer *layer = &engine->layers[nlayer];
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
+	const TLN_Tileset tileset = layer->tileset;
+	const TLN_Tilemap tilemap = layer->tilemap;
+	const int step = layer->lowres.x;
+	const int stepshift = step >> 1;	/* log2 of 1, 2 or 4 */
+	const int width = layer->clip.x2 - layer->clip.x1;
+	uint32_t* color = (uint32_t*)layer->lowres.buffer;
+	uint32_t* color_pri = color + engine->framebuffer.width;
+	uint8_t* line = (uint8_t*)(color_pri + engine->framebuffer.width);
+	uint8_t* line_pri = line + engine->framebuffer.width + 1;
+	int xpos, ypos, row, skip;
+
+	/* samples are aligned to the layer, not the screen, so they move along with it */
+	xpos = (layer->hstart + layer->clip.x1) % layer->width;
+	skip = xpos % step;
+	ypos = (layer->vstart + nscan) % layer->height;
+	row = ypos / layer->lowres.y;
+
+	/* without column offset the whole scanline maps to a single row: skip if empty */
+	if (!layer->column && tilemap->rowcount[(row*layer->lowres.y) >> tileset->vshift] == 0)
+	{
+		layer->lowres.line = nscan;
+		layer->lowres.row = -1;
+		return false;
+	}
+
+	/* sample at every new row, at the start of the frame, when the layer moves or when
+	 * a raster effect changes its tiles or palette. Column offsets start the rows of
+	 * each column at a different line, so these layers are sampled on every line */
+	if (nscan <= layer->lowres.line || row != layer->lowres.row || xpos != layer->lowres.xpos || layer->column ||
+		tileset != layer->lowres.tileset || tileset->version != layer->lowres.version || tilemap != layer->lowres.tilemap ||
+		palette != layer->lowres.palette || (palette != NULL && palette->version != layer->lowres.palversion))
+	{
+		const int count = (skip + width + step - 1) >> stepshift;
+		int x = 0;
+		int ytile = (row*layer->lowres.y) >> tileset->vshift;
+		int srcy = (row*layer->lowres.y) & tileset->vmask;
+		int srcx = (xpos - skip) & tileset->hmask;
+		int xtile = (xpos - skip) >> tileset->hshift;
+		int column = layer->clip.x1 % tileset->width;
+
+		memset (line, 0, count + 1);
+		memset (line_pri, 0, count + 1);
+		layer->lowres.priority = false;
+		while (x < count)
+		{
+			TLN_Tile tile;
+			int samples;
+
+			/* column offset: update ypos */
+			if (layer->column)
+			{
+				ypos = (layer->vstart + nscan + layer->column[column]) % layer->height;
+				if (ypos < 0)
+					ypos += layer->height;
+				ypos -= ypos % layer->lowres.y;
+				ytile = ypos >> tileset->vshift;
+				srcy  = ypos & tileset->vmask;
+			}
+			tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
+
+			/* samples inside this tile */
+			samples = (tileset->width - srcx + step - 1) >> stepshift;
+			if (samples > count - x)
+				samples = count - x;
+
+			if (tile->index)
+			{
+				const int index = GetResidentTile (tileset, tile->index);
+				uint8_t* flipped = NULL;
+				uint8_t* srcpixel;
+				int direction;
+				int tiley;
+				bool color_key;
+
+				tiley = srcy;
+				if (tile->flags & FLAG_FLIPY)
+					tiley = tileset->height - srcy - 1;
+				if ((tile->flags & FLAG_FLIPX) && engine->preflip)
+					flipped = GetFlippedTile (tileset, index);
+				if ((tile->flags & FLAG_FLIPX) && !flipped)
+				{
+					srcpixel = &GetTilesetPixel (tileset, index, tileset->width - srcx - 1, tiley);
+					direction = -step;
+				}
+				else
+				{
+					if (flipped)
+						srcpixel = flipped + (tiley << tileset->hshift) + srcx;
+					else
+						srcpixel = &GetTilesetPixel (tileset, index, srcx, tiley);
+					direction = step;
+				}
+
+				color_key = tileset->color_key[GetTilesetLine (tileset, index, tiley)];
+				if ((tile->flags & FLAG_PRIORITY) || tileset->attributes[tile->index - 1].priority)
+				{
+					GetBlitter (8, color_key, false, false) (srcpixel, NULL, line_pri + x, samples, direction, 0, NULL);
+					layer->lowres.priority = true;
+				}
+				else
+					GetBlitter (8, color_key, false, false) (srcpixel, NULL, line + x, samples, direction, 0, NULL);
+			}
+
+			/* next tile, maybe skipping tiles narrower than the step */
+			x += samples;
+			srcx += samples*step;
+			while (srcx >= tileset->width)
+			{
+				srcx -= tileset->width;
+				xtile = (xtile + 1) % tilemap->cols;
+				column++;
+			}
+		}
+		/* expand to full resolution */
+		BlitExpand (line, palette, color, width, step, skip, layer->lowres.smooth);
+		if (layer->lowres.priority)
+			BlitExpand (line_pri, palette, color_pri, width, step, skip, layer->lowres.smooth);
+		layer->lowres.row = row;
+		layer->lowres.xpos = xpos;
+		layer->lowres.tileset = tileset;
+		layer->lowres.version = tileset->version;
+		layer->lowres.tilemap = tilemap;
+		layer->lowres.palette = palette;
+		layer->lowres.palversion = palette != NULL? palette->version : 0;
+	}
+	layer->lowres.line = nscan;
+
+	/* copy expanded line */
+	BlitExpanded (line, color, GetFramebufferLine (nscan) + (layer->clip.x1 << 2), width, step, skip, layer->blend);
+	if (layer->lowres.priority)
+		BlitExpanded (line_pri, color_pri, engine->priority + (layer->clip.x1 << 2), width, step, skip, layer->blend);
+	if (engine->ids.line != NULL)
+	{
+		DrawObjectIdsExpanded (OBJECT_ID_LAYER(nlayer), line, engine->ids.line + layer->clip.x1, width, step, skip);
+		if (layer->lowres.priority)
+			DrawObjectIdsExpanded (OBJECT_ID_LAYER(nlayer), line_pri, engine->ids.priority + layer->clip.x1, width, step, skip);
+	}
+	return layer->lowres.priority;
+}
+
 /* draw scanline of tiled background with scaling */
 static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 {
 	const Layer *layer = &engine->layers[nlayer];
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	const TLN_Tileset tileset = layer->tileset;
 	const TLN_Tilemap tilemap = layer->tilemap;
 	int shift;
@@ -270,6 +604,8 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 	uint8_t *dstpixel;
 	uint8_t *dstpixel_pri;
 	uint8_t *dst;
+	uint32_t *ids = NULL;
+	uint32_t *ids_pri = engine->ids.priority;
 	fix_t fix_tilewidth;
 	fix_t fix_x;
 	fix_t dx;
@@ -290,6 +626,8 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 	{
 		shift = 2;
 		dstpixel = GetFramebufferLine (nscan);
+		if (engine->ids.line != NULL)
+			ids = engine->ids.line + layer->clip.x1;
 	}
 
 	/* target lines */
@@ -301,6 +639,18 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 	xtile = xpos >> tileset->hshift;
 	srcx  = xpos & tileset->hmask;
 
+	/* without column offset the whole scanline maps to a single row: skip if empty */
+	if (!layer->column)
+	{
+		ypos = layer->vstart + fix2int(nscan*layer->dy);
+		if (ypos < 0)
+			ypos = layer->height + ypos;
+		else
+			ypos = ypos % layer->height;
+		if (tilemap->rowcount[ypos >> tileset->vshift] == 0)
+			goto draw_end;
+	}
+
 	/* fill whole scanline */
 	fix_x = int2fix (x);
 	column = x % tileset->width;
@@ -325,6 +675,29 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 
 		tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
 
+		/* empty tile without column offset: jump over the whole empty run */
+		if (!tile->index && !layer->column)
+		{
+			int count = GetTilemapEmptyRun (tilemap, ytile, xtile);
+			fix_x += (tileset->width - srcx + (count - 1)*tileset->width) * layer->xfactor;
+			x1 = fix2int (fix_x);
+			if (x1 > layer->clip.x2)
+				x1 = layer->clip.x2;
+			width = (x1 - x) << shift;
+			dstpixel += width;
+			dstpixel_pri += width;
+			if (ids != NULL)
+			{
+				ids += x1 - x;
+				ids_pri += x1 - x;
+			}
+			x = x1;
+			xtile = (xtile + count) % tilemap->cols;
+			srcx = 0;
+			column += count;
+			continue;
+		}
+
 		/* get effective tile width */
 		tilewidth = tileset->width - srcx;
 		dx = int2fix(tilewidth);
@@ -345,8 +718,13 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 		/* paint if tile is not empty */
 		if (tile->index)
 		{
+			const int index = GetResidentTile (tileset, tile->index);
+			uint8_t* flipped = NULL;
+
 			/* volteado H/V */
-			if (tile->flags & FLAG_FLIPX)
+			if ((tile->flags & FLAG_FLIPX) && engine->preflip)
+				flipped = GetFlippedTile (tileset, index);
+			if ((tile->flags & FLAG_FLIPX) && !flipped)
 			{
 				direction = -dx;
 				srcx = tilewidth - 1;
@@ -357,8 +735,11 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 				srcy = tileset->height - srcy - 1;
 
 			/* pinta tile scanline */
-			srcpixel = &GetTilesetPixel (tileset, tile->index, srcx, srcy);
-			if (tile->flags & FLAG_PRIORITY)
+			if (flipped)
+				srcpixel = flipped + (srcy << tileset->hshift) + srcx;
+			else
+				srcpixel = &GetTilesetPixel (tileset, index, srcx, srcy);
+			if ((tile->flags & FLAG_PRIORITY) || tileset->attributes[tile->index - 1].priority)
 			{
 				dst = dstpixel_pri;
 				priority = true;
@@ -367,12 +748,20 @@ static bool DrawLayerScanlineScaling (int nlayer, int nscan)
 			{
 				dst = dstpixel;
 			}
-			line = GetTilesetLine (tileset, tile->index, srcy);
+			line = GetTilesetLine (tileset, index, srcy);
 			color_key = *(tileset->color_key + line);
-			layer->blitters[color_key] (srcpixel, layer->palette, dst, width, direction, 0, layer->blend);
+			layer->blitters[color_key] (srcpixel, palette, dst, width, direction, 0, layer->blend);
+
+			if (ids != NULL)
+				DrawObjectIdsScaling (OBJECT_ID_TILE(nlayer, ytile*tilemap->cols + xtile), srcpixel, dst == dstpixel ? ids : ids_pri, width, direction, 0);
 		}
 
 		/* next tile */
+		if (ids != NULL)
+		{
+			ids += width;
+			ids_pri += width;
+		}
 		width <<= shift;
 		dstpixel += width;
 		dstpixel_pri += width;
@@ -391,9 +780,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend (srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend (srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid (srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid (srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic (OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 
 	return priority;
@@ -405,7 +797,7 @@ static bool DrawLayerScanlineAffine (int nlayer, int nscan)
 	Layer *layer = &engine->layers[nlayer];
 	const TLN_Tileset tileset = layer->tileset;
 	const TLN_Tilemap tilemap = layer->tilemap;
-	const TLN_Palette palette = layer->palette;
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	int shift;
 	TLN_Tile tile;
 	int x, width;
@@ -415,6 +807,13 @@ static bool DrawLayerScanlineAffine (int nlayer, int nscan)
 	int xtile, ytile;
 	int srcx, srcy;
 	uint8_t *dstpixel;
+	Tile* blockedmap = NULL;
+	uint8_t* blockedset = NULL;
+	const int tileshift = tileset->hshift + tileset->vshift;
+	const int* blockx = NULL;
+	const int* blocky = NULL;
+	int blockpitch = 0;
+	uint32_t* ids = NULL;
 	Point2D p1,p2;
 
 	/* mosaic effect */
@@ -432,6 +831,18 @@ static bool DrawLayerScanlineAffine (int nlayer, int nscan)
 		shift = 2;
 		dstpixel = engine->tmpindex;
 		memset (dstpixel, 0, engine->framebuffer.width);
+		if (engine->ids.line != NULL)
+			ids = engine->ids.line;
+	}
+
+	/* cache-friendly copies */
+	if (layer->blocked)
+	{
+		blockedmap = GetBlockedTilemap (tilemap);
+		blockedset = GetBlockedTiles (tileset);
+		blockpitch = tilemap->blockpitch;
+		blockx = tileset->blockx;
+		blocky = tileset->blocky;
 	}
 
 	/* target lines */
@@ -465,7 +876,10 @@ static bool DrawLayerScanlineAffine (int nlayer, int nscan)
 		srcx = xpos & tileset->hmask;
 		srcy = ypos & tileset->vmask;
 
-		tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
+		if (blockedmap != NULL)
+			tile = GetBlockedTile (blockedmap, blockpitch, ytile, xtile);
+		else
+			tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
 
 		/* paint if not empty tile */
 		if (tile->index)
@@ -477,7 +891,12 @@ static bool DrawLayerScanlineAffine (int nlayer, int nscan)
 				srcy = tileset->height - srcy - 1;
 
 			/* pinta scanline tile */
-			*dstpixel = GetTilesetPixel (tileset, tile->index, srcx, srcy);
+			if (blockedset != NULL)
+				*dstpixel = GetBlockedPixel (blockedset, tileshift, blockx, blocky, tile->index, srcx, srcy);
+			else
+				*dstpixel = GetTilesetPixel (tileset, GetResidentTile (tileset, tile->index), srcx, srcy);
+			if (ids != NULL && *dstpixel)
+				ids[x] = OBJECT_ID_TILE(nlayer, ytile*tilemap->cols + xtile);
 		}
 
 		/* next pixel */
@@ -496,9 +915,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend (srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend (srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid (srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid (srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic (OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 	else
 	{
@@ -507,7 +929,7 @@ draw_end:
 		uint8_t* dstptr = GetFramebufferLine (nscan) + offset;
 		int width = layer->clip.x2 - layer->clip.x1;
 
-		layer->blitters[1] (srcptr, layer->palette, dstptr, width, 1, 0, layer->blend);
+		layer->blitters[1] (srcptr, palette, dstptr, width, 1, 0, layer->blend);
 	}
 	return false;
 }
@@ -518,7 +940,7 @@ static bool DrawLayerScanlinePixelMapping (int nlayer, int nscan)
 	Layer *layer = &engine->layers[nlayer];
 	const TLN_Tileset tileset = layer->tileset;
 	const TLN_Tilemap tilemap = layer->tilemap;
-	const TLN_Palette palette = layer->palette;
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	const int hstart = layer->hstart + layer->width;
 	const int vstart = layer->vstart + layer->height;
 	int shift;
@@ -528,6 +950,13 @@ static bool DrawLayerScanlinePixelMapping (int nlayer, int nscan)
 	int xtile, ytile;
 	int srcx, srcy;
 	uint8_t *dstpixel;
+	Tile* blockedmap = NULL;
+	uint8_t* blockedset = NULL;
+	const int tileshift = tileset->hshift + tileset->vshift;
+	const int* blockx = NULL;
+	const int* blocky = NULL;
+	int blockpitch = 0;
+	uint32_t* ids = NULL;
 	TLN_PixelMap* pixel_map;
 
 	/* mosaic effect */
@@ -545,6 +974,18 @@ static bool DrawLayerScanlinePixelMapping (int nlayer, int nscan)
 		shift = 2;
 		dstpixel = engine->tmpindex;
 		memset (dstpixel, 0, engine->framebuffer.width);
+		if (engine->ids.line != NULL)
+			ids = engine->ids.line;
+	}
+
+	/* cache-friendly copies */
+	if (layer->blocked)
+	{
+		blockedmap = GetBlockedTilemap (tilemap);
+		blockedset = GetBlockedTiles (tileset);
+		blockpitch = tilemap->blockpitch;
+		blockx = tileset->blockx;
+		blocky = tileset->blocky;
 	}
 
 	/* target lines */
@@ -563,7 +1004,10 @@ static bool DrawLayerScanlinePixelMapping (int nlayer, int nscan)
 		srcx = xpos & tileset->hmask;
 		srcy = ypos & tileset->vmask;
 
-		tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
+		if (blockedmap != NULL)
+			tile = GetBlockedTile (blockedmap, blockpitch, ytile, xtile);
+		else
+			tile = &tilemap->tiles[ytile*tilemap->cols + xtile];
 
 		/* paint if not empty tile */
 		if (tile->index)
@@ -575,7 +1019,12 @@ static bool DrawLayerScanlinePixelMapping (int nlayer, int nscan)
 				srcy = tileset->height - srcy - 1;
 
 			/* paint tile scanline */
-			*dstpixel = GetTilesetPixel (tileset, tile->index, srcx, srcy);
+			if (blockedset != NULL)
+				*dstpixel = GetBlockedPixel (blockedset, tileshift, blockx, blocky, tile->index, srcx, srcy);
+			else
+				*dstpixel = GetTilesetPixel (tileset, GetResidentTile (tileset, tile->index), srcx, srcy);
+			if (ids != NULL && *dstpixel)
+				ids[x] = OBJECT_ID_TILE(nlayer, ytile*tilemap->cols + xtile);
 		}
 
 		/* next pixel */
@@ -593,9 +1042,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend (srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend (srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid (srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid (srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic (OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 	else
 	{
@@ -604,7 +1056,7 @@ draw_end:
 		uint8_t* dstptr = GetFramebufferLine (nscan) + offset;
 		int width = layer->clip.x2 - layer->clip.x1;
 
-		layer->blitters[1] (srcptr, layer->palette, dstptr, width, 1, 0, layer->blend);
+		layer->blitters[1] (srcptr, palette, dstptr, width, 1, 0, layer->blend);
 	}
 	return true;
 }
@@ -619,6 +1071,7 @@ static bool DrawSpriteScanline (int nsprite, int nscan)
 	uint32_t *dstpixel;
 	int srcx, srcy;
 	int direction;
+	uint8_t *flipped = NULL;
 
 	sprite = &engine->sprites[nsprite];
 
@@ -634,8 +1087,10 @@ static bool DrawSpriteScanline (int nsprite, int nscan)
 	srcy = sprite->srcrect.y1 + (nscan - sprite->dstrect.y1);
 	w = sprite->dstrect.x2 - sprite->dstrect.x1;
 
-	/* H/V flip */
-	if (sprite->flags & FLAG_FLIPX)
+	/* H/V flip: mirrored copy read forwards, or backwards read */
+	if ((sprite->flags & FLAG_FLIPX) && engine->preflip)
+		flipped = GetFlippedSprite (sprite->spriteset, sprite->index);
+	if ((sprite->flags & FLAG_FLIPX) && !flipped)
 	{
 		direction = -1;
 		srcx = sprite->info->w - srcx - 1;
@@ -645,9 +1100,14 @@ static bool DrawSpriteScanline (int nsprite, int nscan)
 	if (sprite->flags & FLAG_FLIPY)
 		srcy = sprite->info->h - srcy - 1;
 
-	srcpixel = sprite->pixels + (srcy*sprite->pitch) + srcx;
+	if (flipped)
+		srcpixel = flipped + (srcy*sprite->info->w) + srcx;
+	else
+		srcpixel = sprite->pixels + (srcy*sprite->pitch) + srcx;
 	dstpixel = (uint32_t*)(dstscan + (sprite->dstrect.x1 << 2));
-	sprite->blitter (srcpixel, sprite->palette, dstpixel, w, direction, 0, sprite->blend);
+	sprite->blitter (srcpixel, GetDrawPalette (sprite->palette), dstpixel, w, direction, 0, sprite->blend);
+	if (engine->ids.line != NULL)
+		DrawObjectIds (OBJECT_ID_SPRITE(nsprite), srcpixel, engine->ids.line + sprite->dstrect.x1, w, direction);
 
 	if (sprite->do_collision)
 	{
@@ -667,6 +1127,7 @@ static bool DrawScalingSpriteScanline (int nsprite, int nscan)
 	int srcx, srcy;
 	int dstw,dstx,dx;
 	struct Palette* palette;
+	uint8_t *flipped = NULL;
 
 	sprite = &engine->sprites[nsprite];
 
@@ -681,8 +1142,10 @@ static bool DrawScalingSpriteScanline (int nsprite, int nscan)
 	srcy = sprite->srcrect.y1 + (nscan - sprite->dstrect.y1)*sprite->dy;
 	dstw = sprite->dstrect.x2 - sprite->dstrect.x1;
 
-	/* H/V flip */
-	if (sprite->flags & FLAG_FLIPX)
+	/* H/V flip: mirrored copy read forwards, or backwards read */
+	if ((sprite->flags & FLAG_FLIPX) && engine->preflip)
+		flipped = GetFlippedSprite (sprite->spriteset, sprite->index);
+	if ((sprite->flags & FLAG_FLIPX) && !flipped)
 	{
 		srcx = int2fix(sprite->info->w) - srcx;
 		dstx = sprite->dstrect.x2;
@@ -696,10 +1159,15 @@ static bool DrawScalingSpriteScanline (int nsprite, int nscan)
 	if (sprite->flags & FLAG_FLIPY)
 		srcy = int2fix(sprite->info->h) - srcy;
 
-	palette = sprite->palette;
-	srcpixel = sprite->pixels + (fix2int(srcy)*sprite->pitch);
+	palette = GetDrawPalette (sprite->palette);
+	if (flipped)
+		srcpixel = flipped + (fix2int(srcy)*sprite->info->w);
+	else
+		srcpixel = sprite->pixels + (fix2int(srcy)*sprite->pitch);
 	dstpixel = (uint32_t*)(dstscan + (sprite->dstrect.x1 << 2));
-	sprite->blitter (srcpixel, sprite->palette, dstpixel, dstw, dx, srcx, sprite->blend);
+	sprite->blitter (srcpixel, palette, dstpixel, dstw, dx, srcx, sprite->blend);
+	if (engine->ids.line != NULL)
+		DrawObjectIdsScaling (OBJECT_ID_SPRITE(nsprite), srcpixel, engine->ids.line + sprite->dstrect.x1, dstw, dx, srcx);
 
 	if (sprite->do_collision)
 	{
@@ -756,7 +1224,9 @@ static bool DrawSpriteScanlineRotation(int nsprite, int nscan)
 
 	srcpixel = sprite->rotation_bitmap->data + (srcy*sprite->rotation_bitmap->pitch) + srcx;
 	dstpixel = (uint32_t*)(dstscan + (sprite->dstrect.x1 << 2));
-	sprite->blitter(srcpixel, sprite->palette, dstpixel, w, direction, 0, sprite->blend);
+	sprite->blitter(srcpixel, GetDrawPalette (sprite->palette), dstpixel, w, direction, 0, sprite->blend);
+	if (engine->ids.line != NULL)
+		DrawObjectIds(OBJECT_ID_SPRITE(nsprite), srcpixel, engine->ids.line + sprite->dstrect.x1, w, direction);
 
 	if (sprite->do_collision)
 	{
@@ -809,12 +1279,78 @@ static void DrawSpriteCollisionScaling (int nsprite, uint8_t *srcpixel, uint16_t
 	}
 }
 
+/* writes object ID where source pixels are opaque */
+static void DrawObjectIds (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int dx)
+{
+	while (width)
+	{
+		if (*srcpixel)
+			*dstid = id;
+		srcpixel += dx;
+		dstid++;
+		width--;
+	}
+}
+
+/* writes object ID where scaled source pixels are opaque */
+static void DrawObjectIdsScaling (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int dx, int srcx)
+{
+	while (width)
+	{
+		if (*(srcpixel + srcx/(1 << FIXED_BITS)))
+			*dstid = id;
+		srcx += dx;
+		dstid++;
+		width--;
+	}
+}
+
+/* writes object ID where source pixels expanded size times are opaque, the first one skip pixels shorter */
+static void DrawObjectIdsExpanded (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int size, int skip)
+{
+	int count = size - skip;
+	while (width)
+	{
+		if (count > width)
+			count = width;
+		if (*srcpixel)
+		{
+			int c;
+			for (c=0; c<count; c++)
+				dstid[c] = id;
+		}
+		srcpixel++;
+		dstid += count;
+		width -= count;
+		count = size;
+	}
+}
+
+/* writes object ID of mosaic blocks whose first source pixel is opaque */
+static void DrawObjectIdsMosaic (uint32_t id, const uint8_t *srcpixel, uint32_t *dstid, int width, int size)
+{
+	while (width)
+	{
+		if (size > width)
+			size = width;
+		if (*srcpixel)
+		{
+			int c;
+			for (c=0; c<size; c++)
+				dstid[c] = id;
+		}
+		srcpixel += size;
+		dstid += size;
+		width -= size;
+	}
+}
+
 /* draws regular bitmap scanline for bitmap-based layer */
 bool DrawBitmapScanline(int nlayer, int nscan)
 {
 	const Layer *layer = &engine->layers[nlayer];
 	TLN_Bitmap bitmap = layer->bitmap;
-	TLN_Palette palette = layer->palette;
+	TLN_Palette palette = GetDrawPalette (layer->palette);
 	uint8_t *srcpixel;
 	int shift;
 	int x, x1;
@@ -859,6 +1395,8 @@ bool DrawBitmapScanline(int nlayer, int nscan)
 
 		srcpixel = (uint8_t*)get_bitmap_ptr(bitmap, xpos, ypos);
 		layer->blitters[color_key](srcpixel, palette, dstpixel, width, direction, 0, layer->blend);
+		if (engine->ids.line != NULL && shift == 2)
+			DrawObjectIds(OBJECT_ID_LAYER(nlayer), srcpixel, engine->ids.line + x, width, direction);
 		x += width;
 		width <<= shift;
 		dstpixel += width;
@@ -874,9 +1412,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend(srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend(srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid(srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid(srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 
 	return false;
@@ -886,6 +1427,7 @@ draw_end:
 bool DrawBitmapScanlineScaling(int nlayer, int nscan)
 {
 	const Layer *layer = &engine->layers[nlayer];
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	int shift;
 	uint8_t *srcpixel;
 	int x, x1;
@@ -951,7 +1493,9 @@ bool DrawBitmapScanlineScaling(int nlayer, int nscan)
 		direction = dx;
 		srcpixel = (uint8_t*)get_bitmap_ptr(layer->bitmap, xpos, ypos);
 		color_key = true;
-		layer->blitters[color_key](srcpixel, layer->palette, dstpixel, width, direction, 0, layer->blend);
+		layer->blitters[color_key](srcpixel, palette, dstpixel, width, direction, 0, layer->blend);
+		if (engine->ids.line != NULL && shift == 2)
+			DrawObjectIdsScaling(OBJECT_ID_LAYER(nlayer), srcpixel, engine->ids.line + x, width, direction, 0);
 
 		/* next */
 		width <<= shift;
@@ -969,9 +1513,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend(srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend(srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid(srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid(srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 
 	return false;
@@ -981,7 +1528,7 @@ draw_end:
 bool DrawBitmapScanlineAffine(int nlayer, int nscan)
 {
 	Layer *layer = &engine->layers[nlayer];
-	const TLN_Palette palette = layer->palette;
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	const TLN_Bitmap bitmap = layer->bitmap;
 	int shift;
 	int x, width;
@@ -1050,9 +1597,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend(srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend(srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid(srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid(srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 	else
 	{
@@ -1061,7 +1611,9 @@ draw_end:
 		uint8_t* dstptr = GetFramebufferLine(nscan) + offset;
 		int width = layer->clip.x2 - layer->clip.x1;
 
-		layer->blitters[1](srcptr, layer->palette, dstptr, width, 1, 0, layer->blend);
+		layer->blitters[1](srcptr, palette, dstptr, width, 1, 0, layer->blend);
+		if (engine->ids.line != NULL)
+			DrawObjectIds(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, 1);
 	}
 	return false;
 }
@@ -1071,7 +1623,7 @@ bool DrawBitmapScanlinePixelMapping(int nlayer, int nscan)
 {
 	Layer *layer = &engine->layers[nlayer];
 	const TLN_Bitmap bitmap = layer->bitmap;
-	const TLN_Palette palette = layer->palette;
+	const TLN_Palette palette = GetDrawPalette (layer->palette);
 	const int hstart = layer->hstart + layer->width;
 	const int vstart = layer->vstart + layer->height;
 	int shift;
@@ -1123,9 +1675,12 @@ draw_end:
 		int width = layer->clip.x2 - layer->clip.x1;
 
 		if (layer->blend != NULL)
-			BlitMosaicBlend(srcptr, layer->palette, dstptr, width, layer->mosaic.w, layer->blend);
+			BlitMosaicBlend(srcptr, palette, dstptr, width, layer->mosaic.w, layer->blend);
 		else
-			BlitMosaicSolid(srcptr, layer->palette, dstptr, width, layer->mosaic.w);
+			BlitMosaicSolid(srcptr, palette, dstptr, width, layer->mosaic.w);
+
+		if (engine->ids.line != NULL)
+			DrawObjectIdsMosaic(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, layer->mosaic.w);
 	}
 	else
 	{
@@ -1134,7 +1689,9 @@ draw_end:
 		uint8_t* dstptr = GetFramebufferLine(nscan) + offset;
 		int width = layer->clip.x2 - layer->clip.x1;
 
-		layer->blitters[1](srcptr, layer->palette, dstptr, width, 1, 0, layer->blend);
+		layer->blitters[1](srcptr, palette, dstptr, width, 1, 0, layer->blend);
+		if (engine->ids.line != NULL)
+			DrawObjectIds(OBJECT_ID_LAYER(nlayer), srcptr, engine->ids.line + layer->clip.x1, width, 1);
 	}
 	return false;
 }
@@ -1151,7 +1708,11 @@ static const ScanDrawPtr drawers[3][MAX_DRAW_MODE] =
 ScanDrawPtr GetLayerDraw (Layer* layer)
 {
 	if (layer->tilemap!=NULL)
+	{
+		if (layer->mode == MODE_NORMAL && layer->mosaic.h == 0 && (layer->lowres.x > 1 || layer->lowres.y > 1))
+			return DrawLayerScanlineLowres;
 		return drawers[0][layer->mode];
+	}
 	else
 		return drawers[2][layer->mode];
 }
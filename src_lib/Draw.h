@@ -31,6 +31,11 @@ typedef enum
 }
 draw_t;
 
+/* object IDs: type in the two top bits, then layer and tile cell or sprite index */
+#define OBJECT_ID_SPRITE(nsprite)	(0x40000000u | (uint32_t)(nsprite))
+#define OBJECT_ID_TILE(nlayer,cell)	(0x80000000u | ((uint32_t)(nlayer) << 24) | ((uint32_t)(cell) & 0xFFFFFF))
+#define OBJECT_ID_LAYER(nlayer)		(0xC0000000u | ((uint32_t)(nlayer) << 24))
+
 typedef bool (*ScanDrawPtr)(int,int);
 typedef struct Layer Layer;
 
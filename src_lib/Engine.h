@@ -26,6 +26,10 @@
 #include "Animation.h"
 #include "Bitmap.h"
 #include "Blitters.h"
+#include "TileCache.h"
+#include "Palette.h"
+#include "Light.h"
+#include "RasterProgram.h"
 
 /* motor */
 typedef struct Engine
@@ -36,6 +40,7 @@ typedef struct Engine
 	uint8_t*	tmpindex;	/* indices temporales para capas transformadas con transparencia */
 	int			numsprites;	/* n de sprites */
 	Sprite*		sprites;	/* puntero a los sprites */
+	SpriteScan*	spritescan;	/* datos de sprite usados en cada scanline */
 	int			numlayers;	/* n de capas */
 	Layer*		layers;		/* puntero a las capas */
 	int			numanimations;
@@ -45,14 +50,86 @@ typedef struct Engine
 	TLN_LogLevel log_level;	/* logging level */
 
 	uint32_t	bgcolor;	/* color de fondo */
+	bool		premultiplied;	/* transparent background and premultiplied alpha output */
 	TLN_Bitmap	bgbitmap;	/* bitmap de fondo */
 	TLN_Palette	bgpalette;	/* paleta de fondo */
 	ScanBlitPtr	blit_fast;	/* blitter para bitmap de fondo */
 	uint8_t*	mod_table;	/* tabla de modulacion */
+	TileCache*	tilecache;	/* optional cache of resolved tiles, NULL if disabled */
+	bool		preflip;	/* draw FLAG_FLIPX tiles and sprites from mirrored copies */
 	void		(*raster)(int);
 	void		(*frame)(int);
 	int line;				/* lnea actual */
 
+	struct
+	{
+		int		count;		/* number of registered interrupts, 0 = raster callback on every line */
+		int		capacity;	/* items allocated in list */
+		int		next;		/* next interrupt to check in current frame */
+		TLN_RasterInterrupt* list;	/* interrupts sorted by line */
+	}
+	interrupts;
+
+	RasterProgram program;	/* raster effects evaluated without callbacks */
+
+	struct
+	{
+		int*	list;		/* sprite indexes in drawing order */
+		int*	tmp;		/* scratch array for validation and sorting */
+		bool	sort;		/* sort by key at the start of each frame */
+	}
+	order;
+
+	struct
+	{
+		int*	list;		/* sprites with pending updates */
+		int		count;		/* number of entries in list */
+	}
+	spritedirty;
+
+	struct
+	{
+		int		sprites;	/* max sprites per line, 0 = unlimited */
+		int		pixels;		/* max sprite pixels per line, 0 = unlimited */
+		TLN_SpriteLimit mode;	/* which sprites are dropped */
+		unsigned int phase;	/* first sprite considered in rotation mode, advances each frame */
+		int		culled;		/* sprite lines dropped in current frame */
+		int*	list;		/* sprites drawn on current line */
+	}
+	spritelimit;
+
+	struct
+	{
+		uint32_t*	buffer;		/* object ID of every framebuffer pixel, NULL if disabled */
+		uint32_t*	priority;	/* IDs of the layer tiles with priority in current line */
+		uint32_t*	line;		/* current line inside buffer */
+	}
+	ids;
+
+	struct
+	{
+		bool		enabled;	/* any transform set, palettes are drawn through the cache */
+		uint32_t	version;	/* renewed on every change to the transform */
+		bool		hasmatrix;	/* matrix is not identity */
+		float		matrix[12];	/* 3x4 color matrix, row major */
+		uint8_t*	lut;		/* 3D lookup table, NULL if disabled */
+		int			lutsize;	/* entries per axis of the lookup table */
+		uint8_t		fade[3];	/* fade color */
+		uint8_t		factor;		/* fade amount, 0 = disabled */
+	}
+	grading;
+
+	struct
+	{
+		TLN_AllocationPolicy policy;	/* what to do on allocations between frames */
+		bool		armed;		/* a frame has started since the policy was set */
+		uint32_t	count;		/* allocations since the last TLN_BeginFrame() */
+	}
+	allocs;
+
+	uint8_t*	animpool;	/* auxiliary palettes and strip states of color cycle animations */
+	LightMap	lightmap;	/* optional light multiplied into the finished scanlines */
+
 	struct
 	{
 		int		width;
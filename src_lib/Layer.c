@@ -24,6 +24,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <stdlib.h>
 #include "Engine.h"
 #include "Draw.h"
 #include "Layer.h"
@@ -48,7 +49,8 @@ static void SelectBlitter (Layer* layer);
  * 
  * \remarks
  * This function doesn't modify the current position nor the blend mode,
- * but assigns the palette of the specified tileset
+ * but assigns the palette of the specified tileset. Tileset animations are restarted only
+ * when the tileset changes, so switching tilemaps from the raster callback is cheap
  *
  * \see
  * TLN_DisableLayer()
@@ -56,6 +58,7 @@ static void SelectBlitter (Layer* layer);
 bool TLN_SetLayer (int nlayer, TLN_Tileset tileset, TLN_Tilemap tilemap)
 {
 	Layer *layer;
+	TLN_Tileset previous;
 	if (nlayer >= engine->numlayers)
 	{
 		TLN_SetLastError (TLN_ERR_IDX_LAYER);
@@ -63,6 +66,9 @@ bool TLN_SetLayer (int nlayer, TLN_Tileset tileset, TLN_Tilemap tilemap)
 	}
 
 	layer = &engine->layers[nlayer];
+	if (tilemap != layer->tilemap)
+		ReleaseLayerText (layer);
+	previous = layer->tileset;
 	layer->ok = false;
 	if (!CheckBaseObject (tilemap, OT_TILEMAP))
 		return false;
@@ -87,26 +93,9 @@ bool TLN_SetLayer (int nlayer, TLN_Tileset tileset, TLN_Tilemap tilemap)
 	layer->ok = true;
 	layer->draw = GetLayerDraw (layer);
 
-	/* aplica atributo de prioridad del tileset al tilemap */
-	if (tileset->attributes != NULL)
-	{
-		const int num_tiles = tilemap->rows * tilemap->cols;
-		int c;
-		Tile* tile = tilemap->tiles;
-		for (c=0; c<num_tiles; c++,tile++)
-		{
-			if (tile->index != 0)
-			{
-				if (tileset->attributes[tile->index - 1].priority == true)
-					tile->flags |= FLAG_PRIORITY;
-				else
-					tile->flags &= ~FLAG_PRIORITY;
-			}
-		}
-	}
-	
-	/* inicia animaciones */
-	if (tileset->sp != NULL)
+	/* reinicia animaciones solo si cambia el tileset, para que cambiar de tilemap
+	 * (por ejemplo desde el raster callback) sea O(1) */
+	if (layer->tileset != previous)
 	{
 		int index, c;
 		TLN_Sequence sequence;
@@ -115,12 +104,12 @@ bool TLN_SetLayer (int nlayer, TLN_Tileset tileset, TLN_Tilemap tilemap)
 		for (c=0; c<engine->numanimations; c++)
 		{
 			Animation* animation = &engine->animations[c];
-			if (animation->idx == nlayer && animation->type == TYPE_TILESET)
+			if (animation->enabled && animation->idx == nlayer && animation->type == TYPE_TILESET)
 				TLN_DisableAnimation (c);
 		}
 
 		/* inicia las del nuevo tileset */
-		sequence = tileset->sp->sequences;
+		sequence = tileset->sp != NULL ? tileset->sp->sequences : NULL;
 		while (sequence != NULL)
 		{
 			index = TLN_GetAvailableAnimation ();
@@ -166,6 +155,7 @@ bool TLN_SetLayerBitmap(int nlayer, TLN_Bitmap bitmap)
 	}
 
 	layer = &engine->layers[nlayer];
+	ReleaseLayerText (layer);
 	layer->ok = false;
 	if (!CheckBaseObject(bitmap, OT_BITMAP))
 		return false;
@@ -465,7 +455,9 @@ bool TLN_GetLayerTile (int nlayer, int x, int y, TLN_TileInfo* info)
 	{
 		info->index = tile->index - 1;
 		info->flags = tile->flags;
-		info->color = GetTilesetPixel (tileset, tile->index, srcx, srcy);
+		if (tileset->attributes[info->index].priority)
+			info->flags |= FLAG_PRIORITY;
+		info->color = GetTilesetPixel (tileset, GetResidentTile (tileset, tile->index), srcx, srcy);
 		info->type = tileset->attributes[info->index].type;
 	}
 	else
@@ -713,6 +705,52 @@ bool TLN_SetLayerPixelMapping (int nlayer, TLN_PixelMap* table)
 	return true;
 }
 
+/*!
+ * \brief
+ * Selects a cache-friendly memory layout for the tiles of an affine or pixel mapped layer
+ * 
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ * 
+ * \param enable
+ * true to sample a copy of the tilemap arranged in blocks of 4x4 tiles and a copy of the
+ * tileset with the pixels of each tile in Morton order, false to sample the original ones.
+ * Tiles up to 64 bytes (8x8) already fit in a cache line and aren't reordered
+ * 
+ * \remarks
+ * Rotated layers walk the tilemap and the tiles along diagonals, touching a new cache line at
+ * almost every step with the regular row-major layout. The copies are made on first use and
+ * kept up to date when tiles or tileset pixels are modified, at the cost of extra memory.
+ * Other render modes ignore this setting
+ * 
+ * \see
+ * TLN_SetLayerAffineTransform(), TLN_SetLayerPixelMapping()
+ */
+bool TLN_SetLayerBlockedLayout (int nlayer, bool enable)
+{
+	Layer *layer;
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	layer->blocked = enable;
+	if (enable && layer->tilemap != NULL)
+	{
+		if (GetBlockedTilemap (layer->tilemap) == NULL)
+		{
+			layer->blocked = false;
+			TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+			return false;
+		}
+		GetBlockedTiles (layer->tileset);
+	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
 /*!
  * \brief
  * Disables scaling or affine transform for the layer
@@ -838,6 +876,7 @@ bool TLN_SetLayerMosaic (int nlayer, int width, int height)
 	layer = &engine->layers[nlayer];
 	layer->mosaic.w = width;
 	layer->mosaic.h = height;
+	layer->draw = GetLayerDraw (layer);
 	SelectBlitter (layer);
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -864,10 +903,358 @@ bool TLN_DisableLayerMosaic (int nlayer)
 
 	layer = &engine->layers[nlayer];
 	layer->mosaic.h = 0;
+	layer->draw = GetLayerDraw (layer);
+	SelectBlitter (layer);
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
 }
 
+/*!
+ * \brief
+ * Draws a layer at reduced resolution, to lower the cost of distant or blurred backgrounds
+ *
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ *
+ * \param xdivisor
+ * Horizontal resolution divisor: 1 (full resolution), 2 or 4
+ *
+ * \param ydivisor
+ * Vertical resolution divisor: 1 (full resolution), 2 or 4
+ *
+ * \param smooth
+ * true to interpolate horizontally between sampled pixels, false to repeat them
+ *
+ * \remarks
+ * Only one pixel of every xdivisor is taken from the tileset, and each sampled row is reused
+ * for ydivisor scanlines. Samples are aligned to the layer so they scroll smoothly with it.
+ * It applies to regular tiled layers without scaling, transformation or mosaic effect; in other
+ * modes the layer is drawn at full resolution. Pass 1,1 to return to full resolution
+ *
+ * \see
+ * TLN_SetLayerMosaic()
+ */
+bool TLN_SetLayerResolution (int nlayer, int xdivisor, int ydivisor, bool smooth)
+{
+	Layer *layer;
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	if ((xdivisor != 1 && xdivisor != 2 && xdivisor != 4) ||
+		(ydivisor != 1 && ydivisor != 2 && ydivisor != 4))
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	layer->lowres.x = xdivisor;
+	layer->lowres.y = ydivisor;
+	layer->lowres.smooth = smooth;
+	layer->lowres.line = engine->framebuffer.height;
+	layer->draw = GetLayerDraw (layer);
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Configures a background layer as a text layer showing characters with a bitmap font
+ *
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ *
+ * \param font
+ * Reference to the tileset with one glyph per tile, in character order
+ *
+ * \param rows
+ * Number of text rows
+ *
+ * \param cols
+ * Number of text columns
+ *
+ * \param first
+ * Character shown by the first tile of the font, usually ' ' or '!'
+ *
+ * \remarks
+ * The text layer is a regular tiled layer whose tilemap is owned by the layer: it can be
+ * scrolled, clipped, blended... like any other layer. Write text with TLN_SetLayerText(). Spaces
+ * and characters without glyph are left empty, so they don't cost any drawing time.
+ *
+ * \see
+ * TLN_SetLayerText(), TLN_ClearLayerText()
+ */
+bool TLN_SetTextLayer (int nlayer, TLN_Tileset font, int rows, int cols, char first)
+{
+	Layer *layer;
+	TLN_Tilemap tilemap;
+	char* buffer;
+	uint8_t* dirty;
+
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	if (!CheckBaseObject (font, OT_TILESET))
+		return false;
+
+	if (rows <= 0 || cols <= 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	tilemap = TLN_CreateTilemap (rows, cols, NULL, 0, font);
+	buffer = calloc (rows*cols, sizeof(char));
+	dirty = calloc (rows, sizeof(uint8_t));
+	CountAllocation (rows*cols + rows);
+	if (!tilemap || !buffer || !dirty)
+	{
+		DeleteBaseObject (tilemap);
+		free (buffer);
+		free (dirty);
+		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+		return false;
+	}
+
+	/* the font tileset doesn't belong to the tilemap */
+	tilemap->owner = false;
+	if (!TLN_SetLayer (nlayer, font, tilemap))
+	{
+		DeleteBaseObject (tilemap);
+		free (buffer);
+		free (dirty);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	layer->text.buffer = buffer;
+	layer->text.dirty = dirty;
+	layer->text.update = false;
+	layer->text.first = (uint8_t)first;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Writes a string inside a text layer
+ *
+ * \param nlayer
+ * Index of a layer configured with TLN_SetTextLayer()
+ *
+ * \param row
+ * Starting row
+ *
+ * \param col
+ * Starting column
+ *
+ * \param text
+ * Null-terminated string to write. A newline character continues in the next row at the
+ * starting column. Text past the last column is clipped
+ *
+ * \remarks
+ * Only the characters that actually change are updated, and the layer tilemap is refreshed
+ * once at the start of the next frame, so rewriting a static HUD every frame costs almost nothing
+ *
+ * \see
+ * TLN_SetTextLayer(), TLN_ClearLayerText()
+ */
+bool TLN_SetLayerText (int nlayer, int row, int col, const char* text)
+{
+	Layer *layer;
+	TLN_Tilemap tilemap;
+	int x;
+
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	if (layer->text.buffer == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
+	if (text == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_NULL_POINTER);
+		return false;
+	}
+
+	tilemap = layer->tilemap;
+	if (row < 0 || row >= tilemap->rows || col < 0 || col >= tilemap->cols)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	x = col;
+	while (*text && row < tilemap->rows)
+	{
+		if (*text == '\n')
+		{
+			row++;
+			x = col;
+		}
+		else if (x < tilemap->cols)
+		{
+			char* cell = &layer->text.buffer[row*tilemap->cols + x];
+			if (*cell != *text)
+			{
+				*cell = *text;
+				layer->text.dirty[row] = true;
+				layer->text.update = true;
+			}
+			x++;
+		}
+		text++;
+	}
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Clears all the text inside a text layer
+ *
+ * \param nlayer
+ * Index of a layer configured with TLN_SetTextLayer()
+ *
+ * \see
+ * TLN_SetTextLayer(), TLN_SetLayerText()
+ */
+bool TLN_ClearLayerText (int nlayer)
+{
+	Layer *layer;
+
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	if (layer->text.buffer == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
+	memset (layer->text.buffer, 0, layer->tilemap->rows * layer->tilemap->cols);
+	memset (layer->text.dirty, true, layer->tilemap->rows);
+	layer->text.update = true;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/* translates dirty rows of a text layer into glyph tiles */
+void UpdateLayerText (Layer* layer)
+{
+	const TLN_Tilemap tilemap = layer->tilemap;
+	const int numglyphs = layer->tileset->numtiles - 1;
+	int row, col;
+
+	for (row=0; row<tilemap->rows; row++)
+	{
+		const char* text = &layer->text.buffer[row*tilemap->cols];
+		Tile* tile = &tilemap->tiles[row*tilemap->cols];
+
+		if (!layer->text.dirty[row])
+			continue;
+
+		for (col=0; col<tilemap->cols; col++, tile++)
+		{
+			const int glyph = (uint8_t)text[col] - layer->text.first;
+			Tile cell = {0, 0};
+
+			if (text[col] != ' ' && glyph >= 0 && glyph < numglyphs)
+				cell.index = glyph + 1;
+			if (tile->index != cell.index)
+				TLN_SetTilemapTile (tilemap, row, col, &cell);
+		}
+		layer->text.dirty[row] = false;
+	}
+	layer->text.update = false;
+}
+
+/* reads the tiles of a virtual tileset in the rows and columns just outside the visible area of a
+ * layer, the next ones to scroll into view. Skipped if the resident tiles can't hold them together
+ * with the visible ones, as they would replace each other every frame */
+void PrefetchLayerTiles (Layer* layer)
+{
+	const TLN_Tileset tileset = layer->tileset;
+	const TLN_Tilemap tilemap = layer->tilemap;
+	int width = engine->framebuffer.width;
+	int height = engine->framebuffer.height;
+	int xpos, ypos;
+	int col1, row1, cols, rows;
+	int c, r;
+
+	if (layer->mode == MODE_SCALING)
+	{
+		width = fix2int (width*layer->dx) + 1;
+		height = fix2int (height*layer->dy) + 1;
+	}
+	else if (layer->mode != MODE_NORMAL)
+		return;
+
+	xpos = layer->hstart % layer->width;
+	if (xpos < 0)
+		xpos += layer->width;
+	ypos = layer->vstart % layer->height;
+	if (ypos < 0)
+		ypos += layer->height;
+
+	/* visible tiles and one more on each side */
+	col1 = (xpos >> tileset->hshift) - 1 + tilemap->cols;
+	row1 = (ypos >> tileset->vshift) - 1 + tilemap->rows;
+	cols = ((xpos + width - 1) >> tileset->hshift) - (xpos >> tileset->hshift) + 3;
+	rows = ((ypos + height - 1) >> tileset->vshift) - (ypos >> tileset->vshift) + 3;
+	if (cols*rows > tileset->resident->numslots)
+		return;
+
+	for (r=0; r<rows; r++)
+	{
+		const int row = (row1 + r) % tilemap->rows;
+		const int step = (r == 0 || r == rows - 1)? 1 : cols - 1;
+		for (c=0; c<cols; c+=step)
+		{
+			const Tile* tile = &tilemap->tiles[row*tilemap->cols + (col1 + c) % tilemap->cols];
+			if (tile->index != 0)
+				LoadResidentTile (tileset, tile->index);
+		}
+	}
+}
+
+/* frees text buffers and the tilemap owned by a text layer */
+void ReleaseLayerText (Layer* layer)
+{
+	if (layer->text.buffer == NULL)
+		return;
+
+	if (layer->tilemap != NULL)
+	{
+		DeleteBlockedTilemap (layer->tilemap);
+		DeleteBaseObject (layer->tilemap);
+	}
+	free (layer->text.buffer);
+	free (layer->text.dirty);
+	layer->text.buffer = NULL;
+	layer->text.dirty = NULL;
+	layer->tilemap = NULL;
+	layer->ok = false;
+}
+
 static void SelectBlitter (Layer* layer)
 {
 	bool scaling = layer->mode == MODE_SCALING;
@@ -56,6 +56,7 @@ typedef struct Layer
 	uint8_t*	blend;		/* puntero a tabla de transparencia (NULL = no hay) */
 	TLN_PixelMap* pixel_map;	/* puntero a tabla de pixel map (NULL = no hay) */
 	draw_t		mode;
+	bool		blocked;	/* affine and pixel map modes sample the blocked copies of tiles */
 	
 	/* */
 	int			hstart;		/* offset de inicio horizontal */
@@ -75,7 +76,39 @@ typedef struct Layer
 		uint8_t* buffer;	/* linea temporal */
 	}
 	mosaic;
+
+	/* reduced resolution */
+	struct
+	{
+		int		 x,y;		/* sampling step, 1 = full resolution */
+		bool	 smooth;	/* interpolate horizontally instead of repeating pixels */
+		uint8_t* buffer;	/* sampled row and its priority tiles, expanded and as palette indexes */
+		int		 line;		/* last line drawn */
+		int		 row;		/* layer row sampled in buffer */
+		int		 xpos;		/* layer column of the first pixel in buffer */
+		bool	 priority;	/* sampled row has priority tiles */
+		TLN_Tileset tileset;	/* tileset sampled in buffer */
+		TLN_Tilemap tilemap;	/* tilemap sampled in buffer */
+		TLN_Palette palette;	/* palette the buffer was expanded with */
+		uint32_t version;	/* tileset version sampled in buffer */
+		uint32_t palversion;	/* palette version the buffer was expanded with */
+	}
+	lowres;
+
+	/* text layer */
+	struct
+	{
+		char*	 buffer;	/* characters, rows*cols, 0 = empty (NULL if not a text layer) */
+		uint8_t* dirty;		/* rows written since last frame */
+		bool	 update;	/* some row is dirty */
+		int		 first;		/* character of the first glyph in the font */
+	}
+	text;
 }
 Layer;
 
+void UpdateLayerText (Layer* layer);
+void ReleaseLayerText (Layer* layer);
+void PrefetchLayerTiles (Layer* layer);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,459 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+ * \file Light.c
+ * Low resolution light map multiplied into the finished scanlines
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Engine.h"
+#include "Light.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHT_SSE2
+#endif
+
+#define MIN_LIGHT_CELL	2
+#define MAX_LIGHT_CELL	64
+
+#define PackLight(r,g,b) \
+	(uint32_t)(0xFF000000 | ((r) << 16) | ((g) << 8) | (b))
+
+/* adds the contribution of a light to the grid points inside its radius */
+static void AddLight (const Light* light)
+{
+	LightMap* lightmap = &engine->lightmap;
+	const int size = 1 << lightmap->shift;
+	const int64_t r2 = (int64_t)light->radius*light->radius;
+	int x1 = light->x - light->radius;
+	int y1 = light->y - light->radius;
+	const int x2 = light->x + light->radius;
+	const int y2 = light->y + light->radius;
+	int i1, i2, j1, j2, i, j;
+
+	if (x2 < 0 || y2 < 0)
+		return;
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+
+	/* grid points inside the bounding box */
+	i1 = (x1 + size - 1) >> lightmap->shift;
+	j1 = (y1 + size - 1) >> lightmap->shift;
+	i2 = x2 >> lightmap->shift;
+	j2 = y2 >> lightmap->shift;
+	if (i2 >= lightmap->cols)
+		i2 = lightmap->cols - 1;
+	if (j2 >= lightmap->rows)
+		j2 = lightmap->rows - 1;
+
+	for (j=j1; j<=j2; j++)
+	{
+		const int64_t dy = (j << lightmap->shift) - light->y;
+		uint32_t* point = &lightmap->grid[j*lightmap->cols];
+
+		for (i=i1; i<=i2; i++)
+		{
+			const int64_t dx = (i << lightmap->shift) - light->x;
+			const int64_t d2 = dx*dx + dy*dy;
+			uint32_t r, g, b;
+			int weight;
+
+			if (d2 >= r2)
+				continue;
+
+			/* squared falloff, 256 at the center */
+			weight = 256 - (int)((d2 << 8)/r2);
+			weight = (weight*weight) >> 8;
+
+			r = ((point[i] >> 16) & 0xFF) + ((light->color[0]*weight) >> 8);
+			g = ((point[i] >> 8) & 0xFF) + ((light->color[1]*weight) >> 8);
+			b = (point[i] & 0xFF) + ((light->color[2]*weight) >> 8);
+			if (r > 255)
+				r = 255;
+			if (g > 255)
+				g = 255;
+			if (b > 255)
+				b = 255;
+			point[i] = PackLight (r, g, b);
+		}
+	}
+}
+
+/* fills the grid with the ambient light and accumulates all the lights */
+static void BuildLightGrid (void)
+{
+	LightMap* lightmap = &engine->lightmap;
+	const uint32_t ambient = PackLight (lightmap->ambient[0], lightmap->ambient[1], lightmap->ambient[2]);
+	const int count = lightmap->cols*lightmap->rows;
+	int c;
+
+	for (c=0; c<count; c++)
+		lightmap->grid[c] = ambient;
+
+	for (c=0; c<lightmap->numlights; c++)
+	{
+		if (lightmap->lights[c].enabled)
+			AddLight (&lightmap->lights[c]);
+	}
+}
+
+/* light between two grid points of the same column, fy in [0, size) */
+static uint32_t LerpLight (uint32_t top, uint32_t bottom, int fy, int shift)
+{
+	const int wy = (1 << shift) - fy;
+	const uint32_t r = ((((top >> 16) & 0xFF)*wy) + (((bottom >> 16) & 0xFF)*fy)) >> shift;
+	const uint32_t g = ((((top >> 8) & 0xFF)*wy) + (((bottom >> 8) & 0xFF)*fy)) >> shift;
+	const uint32_t b = (((top & 0xFF)*wy) + ((bottom & 0xFF)*fy)) >> shift;
+	return PackLight (r, g, b);
+}
+
+/* dst = dst*(light + 1)/256 on each channel. The alpha of the light is 255, so the alpha of the
+ * pixels is preserved */
+static void MultiplyLight (uint32_t* dst, const uint32_t* light, int width)
+{
+	int x = 0;
+
+#ifdef LIGHT_SSE2
+	const __m128i zero = _mm_setzero_si128 ();
+	const __m128i one = _mm_set1_epi16 (1);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128 ((const __m128i*)(dst + x));
+		const __m128i lights = _mm_loadu_si128 ((const __m128i*)(light + x));
+		__m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+		__m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+
+		lo = _mm_mullo_epi16 (lo, _mm_add_epi16 (_mm_unpacklo_epi8 (lights, zero), one));
+		hi = _mm_mullo_epi16 (hi, _mm_add_epi16 (_mm_unpackhi_epi8 (lights, zero), one));
+		lo = _mm_srli_epi16 (lo, 8);
+		hi = _mm_srli_epi16 (hi, 8);
+		_mm_storeu_si128 ((__m128i*)(dst + x), _mm_packus_epi16 (lo, hi));
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		const uint32_t pixel = dst[x];
+		const uint32_t l = light[x];
+		const uint32_t r = (((pixel >> 16) & 0xFF)*(((l >> 16) & 0xFF) + 1)) >> 8;
+		const uint32_t g = (((pixel >> 8) & 0xFF)*(((l >> 8) & 0xFF) + 1)) >> 8;
+		const uint32_t b = ((pixel & 0xFF)*((l & 0xFF) + 1)) >> 8;
+		dst[x] = (pixel & 0xFF000000) | (r << 16) | (g << 8) | b;
+	}
+}
+
+/* multiplies a finished scanline by the light map, upsampled bilinearly from the grid */
+void ApplyLightMap (int line, uint32_t* scan)
+{
+	LightMap* lightmap = &engine->lightmap;
+	const int shift = lightmap->shift;
+	const int size = 1 << shift;
+	const int width = engine->framebuffer.width;
+	const int fy = line & (size - 1);
+	const uint32_t* top;
+	const uint32_t* bottom;
+	uint32_t* dst = lightmap->line;
+	uint32_t left;
+	int i, x;
+
+	if (lightmap->dirty)
+	{
+		BuildLightGrid ();
+		lightmap->dirty = false;
+	}
+
+	top = &lightmap->grid[(line >> shift)*lightmap->cols];
+	bottom = top + lightmap->cols;
+
+	/* linear across each cell between its vertically interpolated corners, in 8.8 fixed point */
+	left = LerpLight (top[0], bottom[0], fy, shift);
+	for (i=0, x=0; x<width; i++, x+=size)
+	{
+		const uint32_t right = LerpLight (top[i + 1], bottom[i + 1], fy, shift);
+		const int count = width - x < size? width - x : size;
+		int c;
+
+		if (left == right)
+		{
+			for (c=0; c<count; c++)
+				dst[c] = left;
+		}
+		else
+		{
+			const int step = 256 >> shift;
+			const int dr = (((int)(right >> 16) & 0xFF) - ((int)(left >> 16) & 0xFF))*step;
+			const int dg = (((int)(right >> 8) & 0xFF) - ((int)(left >> 8) & 0xFF))*step;
+			const int db = (((int)right & 0xFF) - ((int)left & 0xFF))*step;
+			int r = ((left >> 16) & 0xFF) << 8;
+			int g = ((left >> 8) & 0xFF) << 8;
+			int b = (left & 0xFF) << 8;
+
+			for (c=0; c<count; c++)
+			{
+				dst[c] = PackLight (r >> 8, g >> 8, b >> 8);
+				r += dr;
+				g += dg;
+				b += db;
+			}
+		}
+		dst += count;
+		left = right;
+	}
+
+	MultiplyLight (scan, lightmap->line, width);
+}
+
+/* releases the light map of the current context */
+void DeleteLightMap (void)
+{
+	LightMap* lightmap = &engine->lightmap;
+
+	free (lightmap->grid);
+	free (lightmap->line);
+	free (lightmap->lights);
+	lightmap->grid = NULL;
+	lightmap->line = NULL;
+	lightmap->lights = NULL;
+	lightmap->numlights = 0;
+	lightmap->enabled = false;
+}
+
+/*!
+ * \brief
+ * Enables a low resolution light map that multiplies the color of the rendered frame
+ *
+ * \param cellsize
+ * Size in pixels of the light map cells, power of two between 2 and 64
+ *
+ * \param numlights
+ * Number of point lights to allocate, set with TLN_SetLight()
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Light intensity is computed only at the corners of the cells, and interpolated bilinearly for
+ * the pixels inside, so the cost of the lights depends on their area in cells rather than in
+ * pixels. Each finished scanline, including sprites, is multiplied by the light on its way to the
+ * framebuffer. Calling it again discards the previous lights. The ambient light is black until
+ * set with TLN_SetAmbientLight()
+ *
+ * \see
+ * TLN_SetLight(), TLN_SetAmbientLight(), TLN_DisableLightMap()
+ */
+bool TLN_SetLightMap (int cellsize, int numlights)
+{
+	LightMap* lightmap = &engine->lightmap;
+	const int width = engine->framebuffer.width;
+	const int height = engine->framebuffer.height;
+	int shift = 0;
+	int cols, rows;
+	uint32_t* grid;
+	uint32_t* line;
+	Light* lights;
+
+	if (cellsize < MIN_LIGHT_CELL || cellsize > MAX_LIGHT_CELL || (cellsize & (cellsize - 1)) || numlights < 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	while ((1 << shift) < cellsize)
+		shift++;
+	cols = ((width - 1) >> shift) + 2;
+	rows = ((height - 1) >> shift) + 2;
+
+	grid = malloc (cols*rows*sizeof(uint32_t));
+	line = malloc (width*sizeof(uint32_t));
+	lights = calloc (numlights > 0? numlights : 1, sizeof(Light));
+	CountAllocation ((cols*rows + width)*sizeof(uint32_t) + numlights*sizeof(Light));
+	if (grid == NULL || line == NULL || lights == NULL)
+	{
+		free (grid);
+		free (line);
+		free (lights);
+		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+		return false;
+	}
+
+	DeleteLightMap ();
+	lightmap->shift = shift;
+	lightmap->cols = cols;
+	lightmap->rows = rows;
+	lightmap->grid = grid;
+	lightmap->line = line;
+	lightmap->numlights = numlights;
+	lightmap->lights = lights;
+	lightmap->dirty = true;
+	lightmap->enabled = true;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Sets the light intensity of the areas not reached by any light
+ *
+ * \param r
+ * red component (0-255)
+ *
+ * \param g
+ * green component (0-255)
+ *
+ * \param b
+ * blue component (0-255)
+ *
+ * \remarks
+ * 255,255,255 leaves the colors unchanged, and 0,0,0 is total darkness. Lights are added on top
+ * of the ambient light
+ *
+ * \see
+ * TLN_SetLightMap()
+ */
+void TLN_SetAmbientLight (uint8_t r, uint8_t g, uint8_t b)
+{
+	LightMap* lightmap = &engine->lightmap;
+
+	lightmap->ambient[0] = r;
+	lightmap->ambient[1] = g;
+	lightmap->ambient[2] = b;
+	lightmap->dirty = true;
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
+/*!
+ * \brief
+ * Places a point light of the light map
+ *
+ * \param nlight
+ * Light index [0, numlights - 1]
+ *
+ * \param x
+ * Horizontal position of the center, in screen space
+ *
+ * \param y
+ * Vertical position of the center, in screen space
+ *
+ * \param radius
+ * Distance in pixels where the light fades out completely
+ *
+ * \param r
+ * red intensity at the center (0-255)
+ *
+ * \param g
+ * green intensity at the center (0-255)
+ *
+ * \param b
+ * blue intensity at the center (0-255)
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Overlapping lights add up, saturating at full intensity. The light map is rebuilt before the
+ * next scanline only if some light actually changed, so static lights can be set again every
+ * frame at no cost
+ *
+ * \see
+ * TLN_SetLightMap(), TLN_DisableLight()
+ */
+bool TLN_SetLight (int nlight, int x, int y, int radius, uint8_t r, uint8_t g, uint8_t b)
+{
+	LightMap* lightmap = &engine->lightmap;
+	Light* light;
+
+	if (nlight < 0 || nlight >= lightmap->numlights)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LIGHT);
+		return false;
+	}
+
+	if (radius < 1)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	light = &lightmap->lights[nlight];
+	if (!light->enabled || light->x != x || light->y != y || light->radius != radius ||
+		light->color[0] != r || light->color[1] != g || light->color[2] != b)
+	{
+		light->enabled = true;
+		light->x = x;
+		light->y = y;
+		light->radius = radius;
+		light->color[0] = r;
+		light->color[1] = g;
+		light->color[2] = b;
+		lightmap->dirty = true;
+	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Turns off a point light of the light map
+ *
+ * \param nlight
+ * Light index [0, numlights - 1]
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \see
+ * TLN_SetLight()
+ */
+bool TLN_DisableLight (int nlight)
+{
+	LightMap* lightmap = &engine->lightmap;
+
+	if (nlight < 0 || nlight >= lightmap->numlights)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LIGHT);
+		return false;
+	}
+
+	if (lightmap->lights[nlight].enabled)
+	{
+		lightmap->lights[nlight].enabled = false;
+		lightmap->dirty = true;
+	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Disables the light map and releases its lights
+ *
+ * \see
+ * TLN_SetLightMap()
+ */
+void TLN_DisableLightMap (void)
+{
+	DeleteLightMap ();
+	TLN_SetLastError (TLN_ERR_OK);
+}
@@ -0,0 +1,53 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LIGHT_H
+#define _LIGHT_H
+
+#include "Tilengine.h"
+
+/* point light of the light map */
+typedef struct
+{
+	bool		enabled;
+	int			x, y;		/* center in screen space */
+	int			radius;		/* distance where the light fades out */
+	uint8_t		color[3];	/* intensity at the center, RGB */
+}
+Light;
+
+/* low resolution light intensity multiplied into the finished scanlines */
+typedef struct
+{
+	bool		enabled;
+	bool		dirty;		/* lights changed, grid rebuilt before the next line */
+	int			shift;		/* log2 of the cell size */
+	int			cols, rows;	/* grid points, one more than cells in each direction */
+	uint32_t*	grid;		/* light intensity at the cell corners, xRGB */
+	uint32_t*	line;		/* light of every pixel of the current line */
+	uint8_t		ambient[3];	/* intensity where there are no lights, RGB */
+	int			numlights;
+	Light*		lights;
+}
+LightMap;
+
+void ApplyLightMap (int line, uint32_t* scan);
+void DeleteLightMap (void);
+
+#endif
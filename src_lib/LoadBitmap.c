@@ -26,6 +26,7 @@
 #include <string.h>
 #include "Tilengine.h"
 #include "LoadFile.h"
+#include "Object.h"
 #include "png.h"
 #include "DIB.h"
 
@@ -127,6 +128,7 @@ static TLN_Bitmap LoadPNG (const char* filename)
 
 	setjmp(png_jmpbuf(png));
 	row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * height);
+	CountAllocation (sizeof(png_bytep) * height);
 	bitmap = TLN_CreateBitmap (width, height, bit_depth);
 	for (y=0; y<height; y++)
 		row_pointers[y] = (png_byte*) TLN_GetBitmapPtr (bitmap, 0,y);
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "LoadFile.h"
+#include "Object.h"
 
 #define SLASH	  '/'
 #define BACKSLASH '\\'
@@ -104,6 +105,7 @@ uint8_t* LoadFile (const char* filename, size_t* out_size)
 	size = ftell (pf);
 	fseek (pf, 0, SEEK_SET);
 	data = malloc (size + 1);
+	CountAllocation (size + 1);
 	if (data)
 	{
 		fread (data, size, 1, pf);
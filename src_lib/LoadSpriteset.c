@@ -28,6 +28,7 @@
 #include <string.h>
 #include "Tilengine.h"
 #include "LoadFile.h"
+#include "Object.h"
 
 /*!
  * \brief
@@ -78,6 +79,7 @@ TLN_Spriteset TLN_LoadSpriteset (const char* name)
 		entries++;
 
 	sprite_data = malloc (sizeof(TLN_SpriteData)*entries);
+	CountAllocation (sizeof(TLN_SpriteData)*entries);
 	if (!sprite_data)
 	{
 		TLN_DeleteBitmap (bitmap);
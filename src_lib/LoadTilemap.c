@@ -31,6 +31,7 @@
 #include "simplexml.h"
 #include "zlib.h"
 #include "LoadFile.h"
+#include "Object.h"
 
 extern int base64decode (const char* in, int inLen, unsigned char *out, int *outLen);
 static int csvdecode (const char* in, int numtiles, uint32_t* data);
@@ -150,6 +151,7 @@ static void* handler (SimpleXmlParser parser, SimpleXmlEvent evt,
 			uint32_t* data = malloc (size);
 			int c;
 			
+			CountAllocation (size);
 			memset (data, 0, size);
 			if (loader.encoding == ENCODING_CSV)
 				csvdecode (szValue, numtiles, data);
@@ -162,6 +164,7 @@ static void* handler (SimpleXmlParser parser, SimpleXmlEvent evt,
 				{
 					uint8_t* deflated = malloc (size);
 					int in_size = size;
+					CountAllocation (size);
 					base64decode (szValue, (int)strlen(szValue), (unsigned char*)deflated, &in_size);
 					decompress (deflated, in_size, (uint8_t*)data, size);
 					free (deflated);
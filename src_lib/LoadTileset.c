@@ -29,6 +29,7 @@
 #include "Tilengine.h"
 #include "simplexml.h"
 #include "LoadFile.h"
+#include "Object.h"
 
 /* properties */
 typedef enum
@@ -87,6 +88,7 @@ static void* handler (SimpleXmlParser parser, SimpleXmlEvent evt,
 				const int tilecount = atoi(szValue);
 				const int size_attribs = tilecount * sizeof(TLN_TileAttributes);
 				loader.attributes = malloc(size_attribs);
+				CountAllocation (size_attribs);
 				memset (loader.attributes, 0, size_attribs);
 			}
 		}
@@ -17,6 +17,7 @@
 * License along with this library. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "Object.h"
@@ -24,6 +25,7 @@
 
 static uint32_t numobjects = 0;
 static uint32_t numbytes = 0;
+static uint32_t version = 0;
 
 static const char* object_types[] = 
 {
@@ -34,7 +36,8 @@ static const char* object_types[] =
 	"spriteset",
 	"bitmap",
 	"sequence",
-	"sequence pack"
+	"sequence pack",
+	"snapshot"
 };
 
 static const TLN_Error object_errors[] =
@@ -47,12 +50,14 @@ static const TLN_Error object_errors[] =
 	TLN_ERR_REF_BITMAP,
 	TLN_ERR_REF_SEQUENCE,
 	TLN_ERR_REF_SEQPACK,
+	TLN_ERR_REF_SNAPSHOT,
 };
 
 /* crea objecto */
 void* CreateBaseObject (ObjectType type, int size)
 {
 	object_t* object = malloc (size);
+	CountAllocation (size);
 	if (object)
 	{
 		numobjects++;
@@ -106,6 +111,12 @@ bool CheckBaseObject (void* object, ObjectType type)
 	return false;
 }
 
+/* devuelve un nmero de versin nico para identificar el contenido de un objeto */
+uint32_t NewObjectVersion (void)
+{
+	return ++version;
+}
+
 unsigned int GetNumObjects (void)
 {
 	return numobjects;
@@ -116,6 +127,29 @@ unsigned int GetNumBytes (void)
 	return numbytes;
 }
 
+/* memory owned by objects outside their own block (copies created on demand) */
+void AddObjectMemory (int size)
+{
+	numbytes += size;
+	if (size > 0)
+		CountAllocation (size);
+}
+
+/* counts an allocation in the current frame, enforcing the strict allocation policy */
+void CountAllocation (int size)
+{
+	if (engine == NULL)
+		return;
+
+	engine->allocs.count++;
+	if (engine->allocs.armed && engine->allocs.policy != ALLOC_ALLOW)
+	{
+		tln_trace (TLN_LOG_ERRORS, "allocation of %d bytes during frame", size);
+		if (engine->allocs.policy == ALLOC_TRAP)
+			abort ();
+	}
+}
+
 void CopyBaseObject (void* dstobject, void* srcobject)
 {
 	if (srcobject && dstobject)
@@ -33,6 +33,7 @@ typedef enum
 	OT_BITMAP,
 	OT_SEQUENCE,
 	OT_SEQPACK,
+	OT_SNAPSHOT,
 }
 ObjectType;
 
@@ -60,7 +61,11 @@ void  DeleteBaseObject (void* object);
 bool  CheckBaseObject (void* object, ObjectType type);
 void  CopyBaseObject (void* dstobject, void* srcobject);
 
+uint32_t NewObjectVersion (void);
+
 unsigned int GetNumObjects (void);
 unsigned int GetNumBytes (void);
+void AddObjectMemory (int size);
+void CountAllocation (int size);
 
 #endif
@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "Engine.h"
 #include "Tilengine.h"
@@ -48,6 +49,7 @@ TLN_Palette TLN_CreatePalette (int entries)
 	if (palette)
 	{
 		palette->entries = entries;
+		palette->version = NewObjectVersion ();
 		TLN_SetLastError (TLN_ERR_OK);
 		return palette;
 	}
@@ -78,6 +80,7 @@ TLN_Palette TLN_ClonePalette (TLN_Palette src)
 	palette = CloneBaseObject (src);
 	if (palette)
 	{
+		palette->graded = NULL;
 		TLN_SetLastError (TLN_ERR_OK);
 		return palette;
 	}
@@ -99,6 +102,7 @@ bool TLN_DeletePalette (TLN_Palette palette)
 {
 	if (CheckBaseObject (palette, OT_PALETTE))
 	{
+		DeleteGradedPalette (palette);
 		DeleteBaseObject (palette);
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
@@ -132,6 +136,7 @@ bool TLN_SetPaletteColor (TLN_Palette palette, int index, uint8_t r, uint8_t g,
 	{
 		uint32_t* data = (uint32_t*)GetPaletteData (palette, index);
 		*data = PackRGB32(r,g,b);
+		palette->version = NewObjectVersion ();
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
 	}
@@ -151,6 +156,11 @@ bool TLN_SetPaletteColor (TLN_Palette palette, int index, uint8_t r, uint8_t g,
  * 
  * \returns
  * 32-bit integer with the packed color in internal pixel format RGBA
+ *
+ * \remarks
+ * The returned pointer gives write access to the palette, so the palette is considered modified
+ * and any cached tile using it is refreshed. Call this function again after writing to the pointer
+ * between frames.
  */
 uint8_t* TLN_GetPaletteData (TLN_Palette palette, int index)
 {
@@ -163,6 +173,7 @@ uint8_t* TLN_GetPaletteData (TLN_Palette palette, int index)
 	}
 	else
 	{
+		palette->version = NewObjectVersion ();
 		TLN_SetLastError (TLN_ERR_OK);
 		return GetPaletteData (palette, index);
 	}
@@ -334,3 +345,272 @@ bool TLN_ModPaletteColor (TLN_Palette palette, uint8_t r, uint8_t g, uint8_t b,
 {
 	return EditPaletteColor (palette, SelectBlendTable(BLEND_MOD), r,g,b, start,num);
 }
+
+/* samples the color lookup table with trilinear interpolation, components in 0-255 range */
+static void SampleColorLUT (float* rgb)
+{
+	const int size = engine->grading.lutsize;
+	const uint8_t* lut = engine->grading.lut;
+	int pos[3];
+	float frac[3];
+	int c, i;
+
+	for (c=0; c<3; c++)
+	{
+		const float p = rgb[c]*(size - 1)/255.0f;
+		pos[c] = (int)p;
+		if (pos[c] > size - 2)
+			pos[c] = size - 2;
+		frac[c] = p - pos[c];
+	}
+
+	/* red varies fastest, then green, then blue */
+	for (c=0; c<3; c++)
+	{
+		float value = 0;
+		for (i=0; i<8; i++)
+		{
+			const int r = pos[0] + (i & 1);
+			const int g = pos[1] + ((i >> 1) & 1);
+			const int b = pos[2] + (i >> 2);
+			const float weight =
+				(i & 1? frac[0] : 1 - frac[0]) *
+				((i >> 1) & 1? frac[1] : 1 - frac[1]) *
+				(i >> 2? frac[2] : 1 - frac[2]);
+			value += lut[((b*size + g)*size + r)*3 + c]*weight;
+		}
+		rgb[c] = value;
+	}
+}
+
+static uint8_t ClampColor (float value)
+{
+	if (value <= 0)
+		return 0;
+	if (value >= 255)
+		return 255;
+	return (uint8_t)(value + 0.5f);
+}
+
+/* applies the global color transform to a 32 bpp color, keeping alpha */
+uint32_t GetGradedColor (uint32_t color)
+{
+	float rgb[3];
+	uint8_t r,g,b;
+
+	rgb[0] = (float)((color >> 16) & 0xFF);
+	rgb[1] = (float)((color >> 8) & 0xFF);
+	rgb[2] = (float)(color & 0xFF);
+
+	if (engine->grading.hasmatrix)
+	{
+		const float* m = engine->grading.matrix;
+		float out[3];
+		int c;
+
+		for (c=0; c<3; c++, m+=4)
+		{
+			out[c] = m[0]*rgb[0] + m[1]*rgb[1] + m[2]*rgb[2] + m[3];
+			if (out[c] < 0)
+				out[c] = 0;
+			else if (out[c] > 255)
+				out[c] = 255;
+		}
+		memcpy (rgb, out, sizeof(rgb));
+	}
+
+	if (engine->grading.lut != NULL)
+		SampleColorLUT (rgb);
+
+	r = ClampColor (rgb[0]);
+	g = ClampColor (rgb[1]);
+	b = ClampColor (rgb[2]);
+
+	if (engine->grading.factor)
+	{
+		const int factor = engine->grading.factor;
+		r += ((engine->grading.fade[0] - r)*factor)/255;
+		g += ((engine->grading.fade[1] - g)*factor)/255;
+		b += ((engine->grading.fade[2] - b)*factor)/255;
+	}
+
+	return (color & 0xFF000000) | (r << 16) | (g << 8) | b;
+}
+
+/* frees the copy of a palette with the color grading applied */
+void DeleteGradedPalette (TLN_Palette palette)
+{
+	if (palette != NULL && palette->graded != NULL)
+	{
+		AddObjectMemory (-(int)(sizeof(struct Palette) + 4*palette->entries));
+		free (palette->graded);
+		palette->graded = NULL;
+	}
+}
+
+/*
+ * Returns the palette with the global color transform applied. Each palette keeps its own graded
+ * copy, rebuilt only when the palette or the transform change, so grading costs one color
+ * operation per palette entry instead of one per pixel however many palettes are drawn
+ */
+TLN_Palette GetGradedPalette (TLN_Palette palette)
+{
+	TLN_Palette graded = palette->graded;
+	const uint32_t* src;
+	uint32_t* dst;
+	int c;
+
+	if (graded != NULL && palette->gradedversion == palette->version && palette->transform == engine->grading.version)
+		return graded;
+
+	if (graded == NULL)
+	{
+		const int size = sizeof(struct Palette) + 4*palette->entries;
+
+		graded = malloc (size);
+		if (graded == NULL)
+			return palette;
+		memset (graded, 0, sizeof(struct Palette));
+		graded->entries = palette->entries;
+		AddObjectMemory (size);
+		palette->graded = graded;
+	}
+
+	src = (const uint32_t*)palette->data;
+	dst = (uint32_t*)graded->data;
+	for (c=0; c<palette->entries; c++)
+		dst[c] = GetGradedColor (src[c]);
+
+	palette->gradedversion = palette->version;
+	palette->transform = engine->grading.version;
+	graded->version = NewObjectVersion ();
+	return graded;
+}
+
+/* renews the transform after a change, so graded copies are rebuilt when drawn */
+static void UpdateGrading (void)
+{
+	engine->grading.version = NewObjectVersion ();
+	engine->grading.enabled = engine->grading.hasmatrix || engine->grading.lut != NULL || engine->grading.factor != 0;
+}
+
+/*!
+ * \brief
+ * Sets a color matrix applied to all palettes when drawing
+ * 
+ * \param matrix
+ * Array of 12 floats with a 3x4 matrix in row major order, or NULL to disable it. Each output
+ * component is computed as m[0]*r + m[1]*g + m[2]*b + m[3] for red, m[4..7] for green and
+ * m[8..11] for blue, with input and offsets in 0-255 range
+ * 
+ * \remarks
+ * Color grading is applied to the palettes, not to the pixels: a graded copy of each palette is
+ * made the first time it's drawn and reused until the palette or the transform change. The
+ * matrix is applied first, then the lookup table set with TLN_SetColorLUT(), then the fade set
+ * with TLN_SetGlobalFade(). Source palettes aren't modified, and layers and sprites without
+ * palette aren't affected
+ *
+ * \see
+ * TLN_SetColorLUT(), TLN_SetGlobalFade()
+ */
+void TLN_SetColorMatrix (const float* matrix)
+{
+	static const float identity[12] = { 1,0,0,0, 0,1,0,0, 0,0,1,0 };
+
+	if (matrix != NULL)
+		memcpy (engine->grading.matrix, matrix, sizeof(engine->grading.matrix));
+	else
+		memcpy (engine->grading.matrix, identity, sizeof(engine->grading.matrix));
+	engine->grading.hasmatrix = memcmp (engine->grading.matrix, identity, sizeof(identity)) != 0;
+	UpdateGrading ();
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
+/*!
+ * \brief
+ * Sets a 3D color lookup table applied to all palettes when drawing
+ * 
+ * \param lut
+ * Array of size*size*size RGB triplets, with red varying fastest, then green, then blue. Pass
+ * NULL to disable the lookup table. The table is copied
+ * 
+ * \param size
+ * Number of entries per axis (2-64)
+ * 
+ * \returns
+ * true if success or false if error
+ * 
+ * \remarks
+ * Colors between table entries are interpolated trilinearly
+ *
+ * \see
+ * TLN_SetColorMatrix()
+ */
+bool TLN_SetColorLUT (const uint8_t* lut, int size)
+{
+	uint8_t* copy = NULL;
+	const int bytes = size*size*size*3;
+
+	if (lut != NULL)
+	{
+		if (size < 2 || size > 64)
+		{
+			TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+			return false;
+		}
+		copy = malloc (bytes);
+		if (copy == NULL)
+		{
+			TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+			return false;
+		}
+		memcpy (copy, lut, bytes);
+		AddObjectMemory (bytes);
+	}
+
+	if (engine->grading.lut != NULL)
+	{
+		const int oldsize = engine->grading.lutsize;
+		AddObjectMemory (-oldsize*oldsize*oldsize*3);
+		free (engine->grading.lut);
+	}
+
+	engine->grading.lut = copy;
+	engine->grading.lutsize = copy != NULL? size : 0;
+	UpdateGrading ();
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Fades all palettes towards a given color when drawing
+ * 
+ * \param r
+ * Red component of the fade color (0-255)
+ * 
+ * \param g
+ * Green component of the fade color (0-255)
+ * 
+ * \param b
+ * Blue component of the fade color (0-255)
+ * 
+ * \param factor
+ * Amount of fade: 0 = disabled, 255 = full fade color
+ * 
+ * \remarks
+ * The fade is applied to the palettes after the color matrix and lookup table, so fading the
+ * whole screen to black or white doesn't need per-palette animations
+ *
+ * \see
+ * TLN_SetColorMatrix()
+ */
+void TLN_SetGlobalFade (uint8_t r, uint8_t g, uint8_t b, uint8_t factor)
+{
+	engine->grading.fade[0] = r;
+	engine->grading.fade[1] = g;
+	engine->grading.fade[2] = b;
+	engine->grading.factor = factor;
+	UpdateGrading ();
+	TLN_SetLastError (TLN_ERR_OK);
+}
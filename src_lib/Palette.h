@@ -27,6 +27,10 @@ struct Palette
 {
 	DEFINE_OBJECT;
 	int entries;
+	uint32_t version;	/* content version, renewed on every change */
+	TLN_Palette graded;	/* copy with the color grading applied, NULL = not drawn graded yet */
+	uint32_t gradedversion;	/* content version the graded copy was made from */
+	uint32_t transform;	/* version of the color grading the graded copy was made with */
 	uint8_t data[0];
 };
 
@@ -36,4 +40,12 @@ struct Palette
 #define PackRGB32(r,g,b) \
 	(uint32_t)(0xFF000000 | (r << 16) | (g << 8) | b)
 
+/* palette to draw with: derived one if color grading is enabled */
+#define GetDrawPalette(palette) \
+	(engine->grading.enabled && (palette) != NULL? GetGradedPalette (palette) : (palette))
+
+TLN_Palette GetGradedPalette (TLN_Palette palette);
+uint32_t GetGradedColor (uint32_t color);
+void DeleteGradedPalette (TLN_Palette palette);
+
 #endif
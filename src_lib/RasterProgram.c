@@ -0,0 +1,397 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+ * \file RasterProgram.c
+ * Raster effects evaluated by the engine on every scanline, without callbacks
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Engine.h"
+#include "RasterProgram.h"
+
+#define DEG2RAD	(3.1415926f/180)
+
+/* values popped and pushed by each opcode */
+static const struct
+{
+	uint8_t pops;
+	uint8_t pushes;
+}
+stackusage[MAX_RASTER_OP] =
+{
+	{ 0,0 },	/* RASTER_END */
+	{ 0,1 },	/* RASTER_PUSH */
+	{ 0,1 },	/* RASTER_LINE */
+	{ 0,1 },	/* RASTER_TIME */
+	{ 1,1 },	/* RASTER_TABLE */
+	{ 1,2 },	/* RASTER_DUP */
+	{ 2,1 },	/* RASTER_ADD */
+	{ 2,1 },	/* RASTER_SUB */
+	{ 2,1 },	/* RASTER_MUL */
+	{ 2,1 },	/* RASTER_DIV */
+	{ 2,1 },	/* RASTER_MOD */
+	{ 2,1 },	/* RASTER_MIN */
+	{ 2,1 },	/* RASTER_MAX */
+	{ 1,1 },	/* RASTER_SIN */
+	{ 1,1 },	/* RASTER_COS */
+	{ 2,1 },	/* RASTER_LESS */
+	{ 2,1 },	/* RASTER_GREATER */
+	{ 3,1 },	/* RASTER_SELECT */
+	{ 1,0 },	/* RASTER_SKIP */
+	{ 1,0 },	/* RASTER_LAYER_X */
+	{ 1,0 },	/* RASTER_LAYER_Y */
+	{ 2,0 },	/* RASTER_LAYER_SCALING */
+	{ 3,0 },	/* RASTER_BG_COLOR */
+	{ 4,0 },	/* RASTER_PALETTE_COLOR */
+};
+
+/* integer part, safe with out of range values and NaN */
+static int ToInt (float value)
+{
+	if (value >= 1e9f)
+		return 1000000000;
+	if (value <= -1e9f)
+		return -1000000000;
+	if (value != value)
+		return 0;
+	return (int)floorf (value);
+}
+
+static uint8_t ToColor (float value)
+{
+	if (value <= 0)
+		return 0;
+	if (value >= 255)
+		return 255;
+	return (uint8_t)value;
+}
+
+/* stack depth when reaching an operation, false if another path reaches it with a different one */
+static bool MergeDepth (int* depth, int target, int value)
+{
+	if (depth[target] == -1)
+		depth[target] = value;
+	return depth[target] == value;
+}
+
+/* checks that every path through the program keeps the stack within bounds and reaches each
+ * operation with the same depth, so it runs without checks. Skips only go forward, so one pass
+ * in order visits each operation after all the paths leading to it */
+static TLN_Error ValidateRasterProgram (const TLN_RasterOp* program, int count, int tablesize)
+{
+	int* depth;
+	int c;
+	TLN_Error error = TLN_ERR_OK;
+
+	depth = malloc ((count + 1)*sizeof(int));
+	CountAllocation ((count + 1)*sizeof(int));
+	if (depth == NULL)
+		return TLN_ERR_OUT_OF_MEMORY;
+	for (c=0; c<=count; c++)
+		depth[c] = -1;
+	depth[0] = 0;
+
+	for (c=0; c<count && error == TLN_ERR_OK; c++)
+	{
+		const TLN_RasterOp* op = &program[c];
+		int next;
+
+		if ((int)op->opcode < 0 || op->opcode >= MAX_RASTER_OP)
+		{
+			error = TLN_ERR_WRONG_FORMAT;
+			break;
+		}
+
+		switch (op->opcode)
+		{
+		case RASTER_TABLE:
+			if (tablesize == 0)
+				error = TLN_ERR_WRONG_FORMAT;
+			break;
+
+		case RASTER_SKIP:
+			if (op->param < 0 || op->param > count - c - 1)
+				error = TLN_ERR_WRONG_FORMAT;
+			break;
+
+		case RASTER_LAYER_X:
+		case RASTER_LAYER_Y:
+		case RASTER_LAYER_SCALING:
+		case RASTER_PALETTE_COLOR:
+			if (op->param < 0 || op->param >= engine->numlayers)
+				error = TLN_ERR_IDX_LAYER;
+			break;
+
+		default:
+			break;
+		}
+
+		/* unreachable */
+		if (error != TLN_ERR_OK || depth[c] == -1)
+			continue;
+
+		if (depth[c] < stackusage[op->opcode].pops)
+		{
+			error = TLN_ERR_WRONG_FORMAT;
+			break;
+		}
+		next = depth[c] - stackusage[op->opcode].pops + stackusage[op->opcode].pushes;
+		if (next > RASTER_STACK)
+		{
+			error = TLN_ERR_WRONG_FORMAT;
+			break;
+		}
+
+		/* successors: next operation, and the skip target */
+		if (op->opcode == RASTER_END)
+			continue;
+		if (!MergeDepth (depth, c + 1, next))
+			error = TLN_ERR_WRONG_FORMAT;
+		if (op->opcode == RASTER_SKIP && !MergeDepth (depth, c + 1 + op->param, next))
+			error = TLN_ERR_WRONG_FORMAT;
+	}
+
+	free (depth);
+	return error;
+}
+
+/* evaluates the raster program for a scanline */
+void RunRasterProgram (int line)
+{
+	const RasterProgram* program = &engine->program;
+	float stack[RASTER_STACK];
+	float* top = stack;	/* next free slot */
+	int c;
+
+	for (c=0; c<program->count; c++)
+	{
+		const TLN_RasterOp* op = &program->ops[c];
+		float a, b;
+
+		switch (op->opcode)
+		{
+		case RASTER_END:
+			return;
+
+		case RASTER_PUSH:
+			*top++ = op->value;
+			break;
+
+		case RASTER_LINE:
+			*top++ = (float)line;
+			break;
+
+		case RASTER_TIME:
+			*top++ = (float)program->time;
+			break;
+
+		case RASTER_TABLE:
+		{
+			int index = ToInt (top[-1]) % program->tablesize;
+			if (index < 0)
+				index += program->tablesize;
+			top[-1] = program->table[index];
+			break;
+		}
+
+		case RASTER_DUP:
+			top[0] = top[-1];
+			top++;
+			break;
+
+		case RASTER_ADD:
+		case RASTER_SUB:
+		case RASTER_MUL:
+		case RASTER_DIV:
+		case RASTER_MOD:
+		case RASTER_MIN:
+		case RASTER_MAX:
+		case RASTER_LESS:
+		case RASTER_GREATER:
+			b = *--top;
+			a = top[-1];
+			switch (op->opcode)
+			{
+			case RASTER_ADD: a += b; break;
+			case RASTER_SUB: a -= b; break;
+			case RASTER_MUL: a *= b; break;
+			case RASTER_DIV: a = b != 0? a/b : 0; break;
+			case RASTER_MOD: a = b != 0? a - b*floorf (a/b) : 0; break;
+			case RASTER_MIN: a = a < b? a : b; break;
+			case RASTER_MAX: a = a > b? a : b; break;
+			case RASTER_LESS: a = a < b? 1.0f : 0.0f; break;
+			case RASTER_GREATER: a = a > b? 1.0f : 0.0f; break;
+			default: break;
+			}
+			top[-1] = a;
+			break;
+
+		case RASTER_SIN:
+			top[-1] = sinf (top[-1]*DEG2RAD);
+			break;
+
+		case RASTER_COS:
+			top[-1] = cosf (top[-1]*DEG2RAD);
+			break;
+
+		case RASTER_SELECT:
+			top -= 2;
+			if (top[1] == 0)
+				top[-1] = top[0];
+			break;
+
+		case RASTER_SKIP:
+			if (*--top == 0)
+				c += op->param;
+			break;
+
+		case RASTER_LAYER_X:
+			top--;
+			TLN_SetLayerPosition (op->param, ToInt (top[0]), engine->layers[op->param].vstart);
+			break;
+
+		case RASTER_LAYER_Y:
+			top--;
+			TLN_SetLayerPosition (op->param, engine->layers[op->param].hstart, ToInt (top[0]));
+			break;
+
+		case RASTER_LAYER_SCALING:
+			top -= 2;
+			if (top[0] > 0 && top[1] > 0)
+				TLN_SetLayerScaling (op->param, top[0], top[1]);
+			break;
+
+		case RASTER_BG_COLOR:
+			top -= 3;
+			TLN_SetBGColor (ToColor (top[0]), ToColor (top[1]), ToColor (top[2]));
+			break;
+
+		case RASTER_PALETTE_COLOR:
+		{
+			TLN_Palette palette = engine->layers[op->param].palette;
+			int index;
+			top -= 4;
+			index = ToInt (top[0]);
+			if (palette != NULL && index >= 0 && index < palette->entries)
+				TLN_SetPaletteColor (palette, index, ToColor (top[1]), ToColor (top[2]), ToColor (top[3]));
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+}
+
+/* releases the raster program of the current context */
+void DeleteRasterProgram (void)
+{
+	RasterProgram* program = &engine->program;
+
+	free (program->ops);
+	free (program->table);
+	program->ops = NULL;
+	program->table = NULL;
+	program->count = 0;
+	program->tablesize = 0;
+}
+
+/*!
+ * \brief
+ * Sets a program evaluated by the engine on every scanline to produce raster effects without callbacks
+ *
+ * \param program
+ * Array of TLN_RasterOp items, or NULL to remove the current program
+ *
+ * \param count
+ * Number of items in the array
+ *
+ * \param table
+ * Optional array of values read by RASTER_TABLE, for example a wave or a color ramp. NULL if unused
+ *
+ * \param tablesize
+ * Number of items in the table
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * The program is a sequence of operations on a stack of numbers, run from the start on each
+ * scanline before the raster callback. Operations push the scanline, the frame timestamp, constants
+ * or table entries, combine them with arithmetic, trigonometric and comparison operations, and
+ * finally pop the results into the layer positions, layer scaling, background color or layer
+ * palette colors. RASTER_SKIP jumps forward only, so a program always ends. It's validated when set:
+ * every path must keep the stack within 16 values and layer indexes must exist, otherwise the call
+ * fails with TLN_ERR_WRONG_FORMAT or TLN_ERR_IDX_LAYER and the previous program is kept. The program
+ * and the table are copied, so the arrays can be released after the call.
+ *
+ * This gives language bindings raster effects at native speed, with no callback crossing per line
+ *
+ * \see
+ * TLN_SetRasterCallback(), TLN_SetRasterInterrupts()
+ */
+bool TLN_SetRasterProgram (const TLN_RasterOp* program, int count, const float* table, int tablesize)
+{
+	TLN_RasterOp* ops = NULL;
+	float* data = NULL;
+	TLN_Error error;
+
+	if (program == NULL || count <= 0)
+	{
+		DeleteRasterProgram ();
+		TLN_SetLastError (TLN_ERR_OK);
+		return true;
+	}
+
+	if (table == NULL || tablesize < 0)
+		tablesize = 0;
+
+	error = ValidateRasterProgram (program, count, tablesize);
+	if (error != TLN_ERR_OK)
+	{
+		TLN_SetLastError (error);
+		return false;
+	}
+
+	ops = malloc (count*sizeof(TLN_RasterOp));
+	if (tablesize > 0)
+		data = malloc (tablesize*sizeof(float));
+	CountAllocation (count*sizeof(TLN_RasterOp) + tablesize*sizeof(float));
+	if (ops == NULL || (tablesize > 0 && data == NULL))
+	{
+		free (ops);
+		free (data);
+		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+		return false;
+	}
+	memcpy (ops, program, count*sizeof(TLN_RasterOp));
+	if (tablesize > 0)
+		memcpy (data, table, tablesize*sizeof(float));
+
+	DeleteRasterProgram ();
+	engine->program.ops = ops;
+	engine->program.count = count;
+	engine->program.table = data;
+	engine->program.tablesize = tablesize;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
@@ -0,0 +1,41 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RASTERPROGRAM_H
+#define _RASTERPROGRAM_H
+
+#include "Tilengine.h"
+
+#define RASTER_STACK	16	/* max values on the stack of a raster program */
+
+/* validated raster program */
+typedef struct
+{
+	TLN_RasterOp*	ops;
+	int				count;		/* number of operations, 0 = disabled */
+	float*			table;		/* user data for RASTER_TABLE */
+	int				tablesize;
+	int				time;		/* timestamp of the current frame */
+}
+RasterProgram;
+
+void RunRasterProgram (int line);
+void DeleteRasterProgram (void);
+
+#endif
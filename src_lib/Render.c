@@ -0,0 +1,441 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+ * \file Render.c
+ * Offscreen rendering of tilemaps into bitmaps
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "Engine.h"
+#include "Tilemap.h"
+#include "Tileset.h"
+#include "Bitmap.h"
+#include "Palette.h"
+
+#define MAX_RENDER_THREADS	8
+#define MIN_THREAD_PIXELS	(512*512)	/* source pixels worth a thread of their own */
+
+/* region of a tilemap rendered into a band of rows of a bitmap */
+typedef struct
+{
+	TLN_Tilemap tilemap;
+	TLN_Tileset tileset;
+	const uint32_t* colors;	/* palette for 32 bpp output */
+	int x, y;				/* top left corner of the region, in tilemap pixels */
+	int width, height;		/* size of the region */
+	int mapwidth, mapheight;/* size of the whole tilemap, in pixels */
+	TLN_Bitmap bitmap;
+	bool smooth;			/* area averaging instead of nearest sampling */
+	int row1, row2;			/* band of target rows */
+}
+RenderJob;
+
+/* color index of a tilemap pixel, 0 = transparent. The tilemap wraps around */
+static uint8_t GetMapPixel (const RenderJob* job, int x, int y)
+{
+	const TLN_Tileset tileset = job->tileset;
+	const Tile* tile;
+	int srcx, srcy;
+
+	x %= job->mapwidth;
+	if (x < 0)
+		x += job->mapwidth;
+	y %= job->mapheight;
+	if (y < 0)
+		y += job->mapheight;
+
+	tile = &job->tilemap->tiles[(y >> tileset->vshift)*job->tilemap->cols + (x >> tileset->hshift)];
+	if (tile->index == 0)
+		return 0;
+
+	srcx = x & tileset->hmask;
+	srcy = y & tileset->vmask;
+	if (tile->flags & FLAG_FLIPX)
+		srcx = tileset->width - srcx - 1;
+	if (tile->flags & FLAG_FLIPY)
+		srcy = tileset->height - srcy - 1;
+	return GetTilesetPixel (tileset, GetResidentTile (tileset, tile->index), srcx, srcy);
+}
+
+/* nearest sampling: the pixel at the center of each target pixel */
+static void RenderNearest (const RenderJob* job)
+{
+	const TLN_Bitmap bitmap = job->bitmap;
+	int x, y;
+
+	for (y=job->row1; y<job->row2; y++)
+	{
+		const int srcy = job->y + (int)(((int64_t)(2*y + 1)*job->height)/(2*bitmap->height));
+		uint8_t* dstptr = get_bitmap_ptr (bitmap, 0, y);
+
+		for (x=0; x<bitmap->width; x++)
+		{
+			const int srcx = job->x + (int)(((int64_t)(2*x + 1)*job->width)/(2*bitmap->width));
+			const uint8_t index = GetMapPixel (job, srcx, srcy);
+
+			if (bitmap->bpp == 8)
+				dstptr[x] = index;
+			else
+				((uint32_t*)dstptr)[x] = index? job->colors[index] : 0;
+		}
+	}
+}
+
+/* area averaging: mean color of the pixels covered by each target pixel, with their coverage
+ * as alpha. Transparent pixels don't contribute to the color */
+static void RenderAverage (const RenderJob* job)
+{
+	const TLN_Bitmap bitmap = job->bitmap;
+	int x, y;
+
+	for (y=job->row1; y<job->row2; y++)
+	{
+		const int y1 = job->y + (int)(((int64_t)y*job->height)/bitmap->height);
+		int y2 = job->y + (int)(((int64_t)(y + 1)*job->height)/bitmap->height);
+		uint32_t* dstptr = (uint32_t*)get_bitmap_ptr (bitmap, 0, y);
+
+		if (y2 == y1)
+			y2 = y1 + 1;
+
+		for (x=0; x<bitmap->width; x++)
+		{
+			const int x1 = job->x + (int)(((int64_t)x*job->width)/bitmap->width);
+			int x2 = job->x + (int)(((int64_t)(x + 1)*job->width)/bitmap->width);
+			uint64_t r = 0, g = 0, b = 0;	/* 64 bit: a large region may fall into one pixel */
+			uint64_t count = 0;
+			int sx, sy;
+
+			if (x2 == x1)
+				x2 = x1 + 1;
+
+			for (sy=y1; sy<y2; sy++)
+			{
+				for (sx=x1; sx<x2; sx++)
+				{
+					const uint8_t index = GetMapPixel (job, sx, sy);
+					if (index)
+					{
+						const uint32_t color = job->colors[index];
+						r += (color >> 16) & 0xFF;
+						g += (color >> 8) & 0xFF;
+						b += color & 0xFF;
+						count++;
+					}
+				}
+			}
+
+			if (count)
+			{
+				const uint32_t alpha = (uint32_t)(count*255/((uint64_t)(x2 - x1)*(y2 - y1)));
+				dstptr[x] = (alpha << 24) | (uint32_t)((r/count) << 16) | (uint32_t)((g/count) << 8) | (uint32_t)(b/count);
+			}
+			else
+				dstptr[x] = 0;
+		}
+	}
+}
+
+static void RunRenderJob (const RenderJob* job)
+{
+	if (job->smooth)
+		RenderAverage (job);
+	else
+		RenderNearest (job);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI RenderThread (LPVOID param)
+{
+	RunRenderJob ((const RenderJob*)param);
+	return 0;
+}
+#else
+static void* RenderThread (void* param)
+{
+	RunRenderJob ((const RenderJob*)param);
+	return NULL;
+}
+#endif
+
+static int GetNumProcessors (void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo (&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	return (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/* splits the target in bands of rows rendered in parallel, the last one in the calling thread */
+static void RenderBands (const RenderJob* job, int numthreads)
+{
+	RenderJob jobs[MAX_RENDER_THREADS];
+#ifdef _WIN32
+	HANDLE threads[MAX_RENDER_THREADS];
+#else
+	pthread_t threads[MAX_RENDER_THREADS];
+#endif
+	bool started[MAX_RENDER_THREADS];
+	const int rows = job->bitmap->height;
+	int c;
+
+	for (c=0; c<numthreads; c++)
+	{
+		jobs[c] = *job;
+		jobs[c].row1 = rows*c/numthreads;
+		jobs[c].row2 = rows*(c + 1)/numthreads;
+		started[c] = false;
+		if (c == numthreads - 1)
+			break;
+#ifdef _WIN32
+		threads[c] = CreateThread (NULL, 0, RenderThread, &jobs[c], 0, NULL);
+		started[c] = threads[c] != NULL;
+#else
+		started[c] = pthread_create (&threads[c], NULL, RenderThread, &jobs[c]) == 0;
+#endif
+		/* couldn't start the thread: render its band here */
+		if (!started[c])
+			RunRenderJob (&jobs[c]);
+	}
+
+	RunRenderJob (&jobs[numthreads - 1]);
+
+	for (c=0; c<numthreads - 1; c++)
+	{
+		if (!started[c])
+			continue;
+#ifdef _WIN32
+		WaitForSingleObject (threads[c], INFINITE);
+		CloseHandle (threads[c]);
+#else
+		pthread_join (threads[c], NULL);
+#endif
+	}
+}
+
+/* common part of the tilemap and layer versions, once validated */
+static bool RenderTilemap (TLN_Tilemap tilemap, TLN_Tileset tileset, TLN_Palette palette, int x, int y, int width, int height, TLN_Bitmap bitmap, bool smooth)
+{
+	RenderJob job;
+	int64_t work;
+	int numthreads;
+
+	job.tilemap = tilemap;
+	job.tileset = tileset;
+	job.colors = palette != NULL? (const uint32_t*)palette->data : NULL;
+	job.x = x;
+	job.y = y;
+	job.width = width;
+	job.height = height;
+	job.mapwidth = tilemap->cols * tileset->width;
+	job.mapheight = tilemap->rows * tileset->height;
+	job.bitmap = bitmap;
+	job.smooth = smooth && bitmap->bpp == 32;
+	job.row1 = 0;
+	job.row2 = bitmap->height;
+
+	/* virtual tilesets load tiles on demand, so they're rendered in a single thread */
+	work = job.smooth? (int64_t)width*height : (int64_t)bitmap->width*bitmap->height;
+	numthreads = 1;
+	if (tileset->resident == NULL && work >= 2*MIN_THREAD_PIXELS)
+	{
+		numthreads = GetNumProcessors ();
+		if (numthreads > MAX_RENDER_THREADS)
+			numthreads = MAX_RENDER_THREADS;
+		if (numthreads > work/MIN_THREAD_PIXELS)
+			numthreads = (int)(work/MIN_THREAD_PIXELS);
+		if (numthreads > bitmap->height)
+			numthreads = bitmap->height;
+		if (numthreads < 1)
+			numthreads = 1;
+	}
+
+	if (numthreads > 1)
+		RenderBands (&job, numthreads);
+	else
+		RunRenderJob (&job);
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Renders a region of a tilemap into a bitmap, scaled to fill it
+ *
+ * \param tilemap
+ * Reference to the tilemap to render
+ *
+ * \param tileset
+ * Reference to the tileset to draw it with, or NULL to use the one attached to the tilemap
+ *
+ * \param x
+ * Left edge of the region, in pixels
+ *
+ * \param y
+ * Top edge of the region, in pixels
+ *
+ * \param width
+ * Width of the region in pixels, or 0 along with height to render the whole tilemap
+ *
+ * \param height
+ * Height of the region in pixels, or 0 along with width to render the whole tilemap
+ *
+ * \param bitmap
+ * Reference to the target bitmap, of 8 or 32 bpp. Its whole surface is overwritten
+ *
+ * \param smooth
+ * true to average all the pixels covered by each target pixel, false to take the nearest one
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * The region can be any size, so the same call makes minimaps, thumbnails or enlarged previews.
+ * It wraps around the edges of the tilemap like a scrolling layer. 8 bpp bitmaps receive the
+ * color indexes of the tileset, always with nearest sampling. 32 bpp bitmaps receive the colors of
+ * the tileset palette, with alpha 0 where the tilemap is empty and partial alpha on the edges of
+ * the tiles when averaging. The engine context isn't involved, so it can be called at any time
+ * and doesn't trigger raster effects. Big regions are split among several threads
+ *
+ * \see
+ * TLN_RenderLayerToBitmap()
+ */
+bool TLN_RenderTilemapToBitmap (TLN_Tilemap tilemap, TLN_Tileset tileset, int x, int y, int width, int height, TLN_Bitmap bitmap, bool smooth)
+{
+	if (!CheckBaseObject (tilemap, OT_TILEMAP) || !CheckBaseObject (bitmap, OT_BITMAP))
+		return false;
+
+	if (tileset == NULL)
+		tileset = tilemap->tileset;
+	if (!CheckBaseObject (tileset, OT_TILESET))
+		return false;
+
+	if (bitmap->bpp != 8 && bitmap->bpp != 32)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
+	if (bitmap->bpp == 32 && !CheckBaseObject (tileset->palette, OT_PALETTE))
+		return false;
+
+	if (width == 0 && height == 0)
+	{
+		x = y = 0;
+		width = tilemap->cols * tileset->width;
+		height = tilemap->rows * tileset->height;
+	}
+	if (width <= 0 || height <= 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	return RenderTilemap (tilemap, tileset, tileset->palette, x, y, width, height, bitmap, smooth);
+}
+
+/*!
+ * \brief
+ * Renders a region of a tiled layer into a bitmap, scaled to fill it
+ *
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ *
+ * \param x
+ * Left edge of the region, in pixels
+ *
+ * \param y
+ * Top edge of the region, in pixels
+ *
+ * \param width
+ * Width of the region in pixels, or 0 along with height to render the whole layer
+ *
+ * \param height
+ * Height of the region in pixels, or 0 along with width to render the whole layer
+ *
+ * \param bitmap
+ * Reference to the target bitmap, of 8 or 32 bpp. Its whole surface is overwritten
+ *
+ * \param smooth
+ * true to average all the pixels covered by each target pixel, false to take the nearest one
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Same as TLN_RenderTilemapToBitmap() with the tilemap, tileset and palette currently assigned
+ * to the layer. Position, transformations, blending and raster effects of the layer are ignored
+ *
+ * \see
+ * TLN_RenderTilemapToBitmap()
+ */
+bool TLN_RenderLayerToBitmap (int nlayer, int x, int y, int width, int height, TLN_Bitmap bitmap, bool smooth)
+{
+	const Layer* layer;
+
+	if (nlayer >= engine->numlayers)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_LAYER);
+		return false;
+	}
+
+	layer = &engine->layers[nlayer];
+	if (layer->tilemap == NULL || layer->tileset == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
+	if (!CheckBaseObject (bitmap, OT_BITMAP))
+		return false;
+
+	if (bitmap->bpp != 8 && bitmap->bpp != 32)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
+	if (bitmap->bpp == 32 && !CheckBaseObject (layer->palette, OT_PALETTE))
+		return false;
+
+	if (width == 0 && height == 0)
+	{
+		x = y = 0;
+		width = layer->width;
+		height = layer->height;
+	}
+	if (width <= 0 || height <= 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	return RenderTilemap (layer->tilemap, layer->tileset, layer->palette, x, y, width, height, bitmap, smooth);
+}
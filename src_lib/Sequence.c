@@ -92,7 +92,7 @@ TLN_Sequence TLN_CreateSequence (const char* name, int target, int count, TLN_Se
  * String with an unique name to query later
  * 
  * \param count
- * Number of color strips
+ * Number of color strips, up to 32
  * 
  * \param strips
  * Array of color strips to assign
@@ -113,6 +113,12 @@ TLN_Sequence TLN_CreateCycle (const char* name, int count, TLN_ColorStrip* strip
 	TLN_ColorStrip* srcstrip;
 	struct Strip* dststrip;
 	
+	if (count < 0 || count > MAX_COLOR_STRIPS)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return NULL;
+	}
+
 	size = count*sizeof(struct Strip);
 	sequence = CreateBaseObject (OT_SEQUENCE, sizeof(struct Sequence) + size);
 	if (!sequence)
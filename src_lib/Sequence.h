@@ -23,16 +23,15 @@
 #include "Object.h"
 #include "Hash.h"
 
-/* ciclo de color */
+#define MAX_COLOR_STRIPS	32
+
+/* ciclo de color. Immutable, the playback state is kept by each animation */
 struct Strip
 {
 	int delay;
-	int timer;
-	int t0;
 	uint8_t first;
 	uint8_t count;
 	uint8_t dir;
-	uint8_t pos;
 };
 
 /* secuencia de sprites y tiles */
@@ -0,0 +1,440 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+ * \file snapshot.c
+ * Capture and restore of the engine state
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "Tilengine.h"
+#include "Engine.h"
+#include "Object.h"
+#include "Tilemap.h"
+#include "Tileset.h"
+#include "Palette.h"
+#include "Sequence.h"
+
+/* copy of a memory block modified while rendering (palettes, tiles, text...) */
+typedef struct
+{
+	uint8_t*	ptr;		/* original location */
+	int			size;		/* bytes, the copy follows this header */
+}
+Image;
+
+/* snapshot: fixed header followed by the engine arrays and the images */
+struct Snapshot
+{
+	DEFINE_OBJECT;
+	int			numsprites;
+	int			numlayers;
+	int			numanimations;
+	int			size_images;	/* bytes used by the images */
+	uint32_t	bgcolor;
+	TLN_Bitmap	bgbitmap;
+	TLN_Palette	bgpalette;
+	ScanBlitPtr	blit_fast;
+	bool		dopriority;
+	bool		sortsprites;
+	int			limitsprites;
+	int			limitpixels;
+	TLN_SpriteLimit limitmode;
+	unsigned int limitphase;
+	bool		hasmatrix;	/* color grading */
+	float		colormatrix[12];
+	uint8_t		fade[3];
+	uint8_t		fadefactor;
+	int			lutsize;
+	uint8_t*	lut;		/* copy of the color lookup table, NULL if disabled */
+	bool		lighting;	/* light map */
+	int			lightshift;
+	int			numlights;
+	uint8_t		ambient[3];
+	Light*		lights;
+	Sprite*		sprites;
+	SpriteScan*	spritescan;
+	int*		order;
+	Layer*		layers;
+	Animation*	animations;
+	uint8_t*	images;		/* sequence of Image headers and data */
+	uint8_t		data[];
+};
+
+typedef bool (*ImageFunc)(uint8_t* ptr, int size, void* param);
+
+/* tiles of a tilemap and their occupancy, without the pointers to the copies made from them */
+#define TilemapData(tilemap) \
+	((uint8_t*)(tilemap)->tiles)
+#define TilemapDataSize(tilemap) \
+	(ObjectSize(tilemap) - (int)sizeof(struct Tilemap))
+
+/* image sizes are kept aligned for the next header */
+#define ImageStride(size) \
+	(int)((sizeof(Image) + (size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+/* calls func for every block modified by the engine itself while rendering */
+static bool ForEachImage (ImageFunc func, void* param)
+{
+	int c;
+
+	/* animations modify palettes, color strip states, tilemaps and tilesets */
+	for (c=0; c<engine->numanimations; c++)
+	{
+		const Animation* animation = &engine->animations[c];
+
+		if (!animation->enabled)
+			continue;
+
+		switch (animation->type)
+		{
+		case TYPE_PALETTE:
+			/* colors and version, keeping the graded copy made since */
+			{
+				const TLN_Palette palette = animation->palette;
+				if (!func ((uint8_t*)animation->strips, animation->sequence->count*(int)sizeof(StripState), param) ||
+					!func (palette->data, palette->entries*4, param) ||
+					!func ((uint8_t*)&palette->version, sizeof(palette->version), param))
+					return false;
+			}
+			break;
+
+		case TYPE_TILEMAP:
+			{
+				const TLN_Tilemap tilemap = engine->layers[animation->idx].tilemap;
+				if (!func (TilemapData(tilemap), TilemapDataSize(tilemap), param))
+					return false;
+			}
+			break;
+
+		case TYPE_TILESET:
+			/* pixels and version, keeping the mirrored copies made since */
+			{
+				const TLN_Tileset tileset = engine->layers[animation->idx].tileset;
+				if (!func (tileset->data, ObjectSize(tileset) - (int)sizeof(struct Tileset), param) ||
+					!func ((uint8_t*)&tileset->version, sizeof(tileset->version), param))
+					return false;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/* text layers own their buffers and tilemap */
+	for (c=0; c<engine->numlayers; c++)
+	{
+		const Layer* layer = &engine->layers[c];
+		const TLN_Tilemap tilemap = layer->tilemap;
+
+		if (layer->text.buffer == NULL)
+			continue;
+
+		if (!func ((uint8_t*)layer->text.buffer, tilemap->rows*tilemap->cols, param) ||
+			!func (layer->text.dirty, tilemap->rows, param) ||
+			!func (TilemapData(tilemap), TilemapDataSize(tilemap), param))
+			return false;
+	}
+	return true;
+}
+
+static bool CountImage (uint8_t* ptr, int size, void* param)
+{
+	int* total = (int*)param;
+	*total += ImageStride (size);
+	return true;
+}
+
+static bool SaveImage (uint8_t* ptr, int size, void* param)
+{
+	uint8_t** dst = (uint8_t**)param;
+	Image* image = (Image*)*dst;
+
+	image->ptr = ptr;
+	image->size = size;
+	memcpy (image + 1, ptr, size);
+	*dst += ImageStride (size);
+	return true;
+}
+
+/*!
+ * \brief
+ * Captures the current state of the engine
+ *
+ * \returns
+ * Reference to the new snapshot, or NULL if error
+ *
+ * \remarks
+ * The snapshot holds the state of layers, sprites, animations, background, color grading and
+ * lights, and the contents of the palettes, tilemaps and tilesets the engine modifies by itself
+ * (animations and text layers). It holds references, not copies, of the rest of assets, so they must stay alive while
+ * the snapshot is in use. Raster and frame callbacks and the render target aren't captured.
+ * Together with a record of the calls made by the application each frame, snapshots allow to
+ * resume a session from any point, for example to render segments of a recorded session in parallel.
+ *
+ * \see
+ * TLN_RestoreSnapshot(), TLN_DeleteSnapshot()
+ */
+TLN_Snapshot TLN_CreateSnapshot (void)
+{
+	TLN_Snapshot snapshot;
+	const int size_sprites = engine->numsprites * sizeof(Sprite);
+	const int size_spritescan = engine->numsprites * sizeof(SpriteScan);
+	const int size_order = engine->numsprites * sizeof(int);
+	const int size_layers = engine->numlayers * sizeof(Layer);
+	const int size_animations = engine->numanimations * sizeof(Animation);
+	const int size_lut = engine->grading.lutsize*engine->grading.lutsize*engine->grading.lutsize*3;
+	const int size_lights = engine->lightmap.enabled? engine->lightmap.numlights * sizeof(Light) : 0;
+	int size_images = 0;
+	uint8_t* dst;
+	int c;
+
+	/* captured state must be up to date */
+	UpdateDirtySprites ();
+
+	ForEachImage (CountImage, &size_images);
+	snapshot = CreateBaseObject (OT_SNAPSHOT, sizeof(struct Snapshot) + size_sprites + size_spritescan + size_order + size_layers + size_animations + size_images + size_lights + size_lut);
+	if (!snapshot)
+		return NULL;
+
+	snapshot->numsprites = engine->numsprites;
+	snapshot->numlayers = engine->numlayers;
+	snapshot->numanimations = engine->numanimations;
+	snapshot->bgcolor = engine->bgcolor;
+	snapshot->bgbitmap = engine->bgbitmap;
+	snapshot->bgpalette = engine->bgpalette;
+	snapshot->blit_fast = engine->blit_fast;
+	snapshot->dopriority = engine->dopriority;
+	snapshot->sortsprites = engine->order.sort;
+	snapshot->limitsprites = engine->spritelimit.sprites;
+	snapshot->limitpixels = engine->spritelimit.pixels;
+	snapshot->limitmode = engine->spritelimit.mode;
+	snapshot->limitphase = engine->spritelimit.phase;
+	snapshot->hasmatrix = engine->grading.hasmatrix;
+	memcpy (snapshot->colormatrix, engine->grading.matrix, sizeof(snapshot->colormatrix));
+	memcpy (snapshot->fade, engine->grading.fade, sizeof(snapshot->fade));
+	snapshot->fadefactor = engine->grading.factor;
+	snapshot->lutsize = engine->grading.lutsize;
+	snapshot->lighting = engine->lightmap.enabled;
+	snapshot->lightshift = engine->lightmap.shift;
+	snapshot->numlights = engine->lightmap.numlights;
+	memcpy (snapshot->ambient, engine->lightmap.ambient, sizeof(snapshot->ambient));
+
+	/* arrays */
+	snapshot->sprites = (Sprite*)snapshot->data;
+	snapshot->spritescan = (SpriteScan*)((uint8_t*)snapshot->sprites + size_sprites);
+	snapshot->order = (int*)((uint8_t*)snapshot->spritescan + size_spritescan);
+	snapshot->layers = (Layer*)((uint8_t*)snapshot->order + size_order);
+	snapshot->animations = (Animation*)((uint8_t*)snapshot->layers + size_layers);
+	snapshot->images = (uint8_t*)snapshot->animations + size_animations;
+	memcpy (snapshot->sprites, engine->sprites, size_sprites);
+	memcpy (snapshot->spritescan, engine->spritescan, size_spritescan);
+	memcpy (snapshot->order, engine->order.list, size_order);
+	memcpy (snapshot->layers, engine->layers, size_layers);
+	memcpy (snapshot->animations, engine->animations, size_animations);
+
+	/* rotated sprites own their bitmap: keep a private copy */
+	for (c=0; c<snapshot->numsprites; c++)
+	{
+		Sprite* sprite = &snapshot->sprites[c];
+		if (sprite->rotation_bitmap != NULL)
+			sprite->rotation_bitmap = TLN_CloneBitmap (sprite->rotation_bitmap);
+	}
+
+	/* blocks modified by the engine */
+	dst = snapshot->images;
+	ForEachImage (SaveImage, &dst);
+	snapshot->size_images = (int)(dst - snapshot->images);
+
+	/* lights and color lookup table, after the images */
+	if (size_lights > 0)
+	{
+		snapshot->lights = (Light*)dst;
+		memcpy (snapshot->lights, engine->lightmap.lights, size_lights);
+		dst += size_lights;
+	}
+	if (size_lut > 0)
+	{
+		snapshot->lut = dst;
+		memcpy (snapshot->lut, engine->grading.lut, size_lut);
+	}
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return snapshot;
+}
+
+/*!
+ * \brief
+ * Restores the state of the engine captured in a snapshot
+ *
+ * \param snapshot
+ * Reference to the snapshot to restore, created in a context with the same number of layers,
+ * sprites and animations
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Text layers must still have the same configuration they had when the snapshot was taken
+ *
+ * \see
+ * TLN_CreateSnapshot()
+ */
+bool TLN_RestoreSnapshot (TLN_Snapshot snapshot)
+{
+	uint8_t* src;
+	uint8_t* end;
+	int c;
+
+	if (!CheckBaseObject (snapshot, OT_SNAPSHOT))
+		return false;
+
+	if (snapshot->numsprites != engine->numsprites || snapshot->numlayers != engine->numlayers ||
+		snapshot->numanimations != engine->numanimations)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	for (c=0; c<engine->numlayers; c++)
+	{
+		if (snapshot->layers[c].text.buffer != engine->layers[c].text.buffer)
+		{
+			TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+			return false;
+		}
+	}
+
+	/* light map and lookup table first, the only state that may need new memory */
+	if (!snapshot->lighting)
+		DeleteLightMap ();
+	else if (!engine->lightmap.enabled || engine->lightmap.shift != snapshot->lightshift || engine->lightmap.numlights != snapshot->numlights)
+	{
+		if (!TLN_SetLightMap (1 << snapshot->lightshift, snapshot->numlights))
+			return false;
+	}
+	if (snapshot->lutsize != engine->grading.lutsize)
+	{
+		if (!TLN_SetColorLUT (snapshot->lut, snapshot->lutsize))
+			return false;
+	}
+	else if (snapshot->lut != NULL)
+		memcpy (engine->grading.lut, snapshot->lut, snapshot->lutsize*snapshot->lutsize*snapshot->lutsize*3);
+
+	/* replace rotation bitmaps */
+	for (c=0; c<engine->numsprites; c++)
+	{
+		Sprite* sprite = &engine->sprites[c];
+		if (sprite->rotation_bitmap != NULL)
+			TLN_DeleteBitmap (sprite->rotation_bitmap);
+	}
+	memcpy (engine->sprites, snapshot->sprites, engine->numsprites * sizeof(Sprite));
+	memcpy (engine->spritescan, snapshot->spritescan, engine->numsprites * sizeof(SpriteScan));
+	engine->spritedirty.count = 0;
+	memcpy (engine->order.list, snapshot->order, engine->numsprites * sizeof(int));
+	engine->order.sort = snapshot->sortsprites;
+	engine->spritelimit.sprites = snapshot->limitsprites;
+	engine->spritelimit.pixels = snapshot->limitpixels;
+	engine->spritelimit.mode = snapshot->limitmode;
+	engine->spritelimit.phase = snapshot->limitphase;
+	for (c=0; c<engine->numsprites; c++)
+	{
+		Sprite* sprite = &engine->sprites[c];
+		if (sprite->rotation_bitmap != NULL)
+			sprite->rotation_bitmap = TLN_CloneBitmap (sprite->rotation_bitmap);
+	}
+
+	/* layers keep their own working buffers */
+	for (c=0; c<engine->numlayers; c++)
+	{
+		uint8_t* buffer = engine->layers[c].mosaic.buffer;
+		uint8_t* lowres = engine->layers[c].lowres.buffer;
+		engine->layers[c] = snapshot->layers[c];
+		engine->layers[c].mosaic.buffer = buffer;
+		engine->layers[c].lowres.buffer = lowres;
+		engine->layers[c].lowres.line = engine->framebuffer.height;
+	}
+	memcpy (engine->animations, snapshot->animations, engine->numanimations * sizeof(Animation));
+
+	engine->bgcolor = snapshot->bgcolor;
+	engine->bgbitmap = snapshot->bgbitmap;
+	engine->bgpalette = snapshot->bgpalette;
+	engine->blit_fast = snapshot->blit_fast;
+	engine->dopriority = snapshot->dopriority;
+
+	/* color grading, renewing the graded palettes */
+	TLN_SetColorMatrix (snapshot->hasmatrix? snapshot->colormatrix : NULL);
+	TLN_SetGlobalFade (snapshot->fade[0], snapshot->fade[1], snapshot->fade[2], snapshot->fadefactor);
+
+	/* lights, the light map is rebuilt before the next line */
+	memcpy (engine->lightmap.ambient, snapshot->ambient, sizeof(snapshot->ambient));
+	if (snapshot->lights != NULL)
+		memcpy (engine->lightmap.lights, snapshot->lights, snapshot->numlights * sizeof(Light));
+	engine->lightmap.dirty = true;
+
+	/* blocks modified by the engine */
+	src = snapshot->images;
+	end = snapshot->images + snapshot->size_images;
+	while (src < end)
+	{
+		Image* image = (Image*)src;
+		memcpy (image->ptr, image + 1, image->size);
+		src += ImageStride (image->size);
+	}
+
+	/* restored tiles may differ anywhere */
+	for (c=0; c<engine->numlayers; c++)
+	{
+		TLN_Tilemap tilemap = engine->layers[c].tilemap;
+		if (engine->layers[c].ok && tilemap != NULL)
+			AddTilemapDirtyRect (tilemap, 0, 0, tilemap->rows, tilemap->cols);
+	}
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Deletes a snapshot and frees its memory
+ *
+ * \param snapshot
+ * Reference to the snapshot to delete
+ *
+ * \see
+ * TLN_CreateSnapshot()
+ */
+bool TLN_DeleteSnapshot (TLN_Snapshot snapshot)
+{
+	int c;
+
+	if (!CheckBaseObject (snapshot, OT_SNAPSHOT))
+		return false;
+
+	for (c=0; c<snapshot->numsprites; c++)
+	{
+		if (snapshot->sprites[c].rotation_bitmap != NULL)
+			TLN_DeleteBitmap (snapshot->sprites[c].rotation_bitmap);
+	}
+	DeleteBaseObject (snapshot);
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
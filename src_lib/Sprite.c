@@ -34,6 +34,12 @@
 
 static void SelectBlitter (Sprite* sprite);
 static void UpdateSprite (Sprite* sprite);
+static void UpdateSpriteScan (Sprite* sprite);
+static void MarkSpriteDirty (Sprite* sprite, uint8_t what);
+
+/* signed key as unsigned with the same order */
+#define SortKey(key) \
+	((uint32_t)(key) ^ 0x80000000)
 
 /*!
  * \brief
@@ -117,6 +123,7 @@ bool TLN_SetSpriteFlags (int nsprite, TLN_TileFlags flags)
 	}
 	
 	engine->sprites[nsprite].flags = flags;
+	MarkSpriteDirty (&engine->sprites[nsprite], SPRITE_DIRTY_SCAN);
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
 }
@@ -153,7 +160,7 @@ bool TLN_SetSpritePosition (int nsprite, int x, int y)
 	sprite = &engine->sprites[nsprite];
 	sprite->x = x;
 	sprite->y = y;
-	UpdateSprite (sprite);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT);
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -194,7 +201,7 @@ bool TLN_SetSpritePicture (int nsprite, int entry)
 	sprite->index = entry;
 	sprite->info = &sprite->spriteset->data[entry];
 	sprite->pixels = sprite->spriteset->bitmap->data + sprite->info->offset;
-	UpdateSprite (sprite);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT);
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -231,6 +238,7 @@ bool TLN_SetSpritePalette (int nsprite, TLN_Palette palette)
 	sprite = &engine->sprites[nsprite];
 	sprite->palette = palette;
 	sprite->ok = sprite->spriteset && sprite->palette;
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_SCAN);
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -288,7 +296,7 @@ bool TLN_SetSpriteBlendMode (int nsprite, TLN_Blend mode, uint8_t factor)
 
 	sprite = &engine->sprites[nsprite];
 	sprite->blend = SelectBlendTable (mode);
-	SelectBlitter (sprite);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_BLITTER);
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -331,8 +339,7 @@ bool TLN_SetSpriteScaling (int nsprite, float sx, float sy)
 	sprite->sy = sy;
 	sprite->mode = MODE_SCALING;
 	sprite->draw = GetSpriteDraw (sprite->mode);
-	UpdateSprite (sprite);
-	SelectBlitter (sprite);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT | SPRITE_DIRTY_BLITTER);
 	return true;
 }
 
@@ -359,10 +366,9 @@ bool TLN_ResetSpriteScaling (int nsprite)
 	sprite->sx = sprite->sy = 1.0f;
 	sprite->mode = MODE_NORMAL;
 	sprite->draw = GetSpriteDraw (sprite->mode);
-	UpdateSprite (sprite);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT | SPRITE_DIRTY_BLITTER);
 	
 	TLN_SetLastError (TLN_ERR_OK);
-	SelectBlitter (sprite);
 	return true;
 }
 
@@ -390,6 +396,39 @@ static void __inline Vector2DAdvance(Vector2D* vector)
 	vector->y += vector->dy;
 }
 
+/* bitmap for the rotated sprite, reusing the previous one when it's big enough. It's created with
+ * room for the diagonal of the sprite, so rotating it again to any angle doesn't allocate */
+static TLN_Bitmap GetRotationBitmap(Sprite* sprite, int width, int height)
+{
+	TLN_Bitmap bitmap = sprite->rotation_bitmap;
+	const int pitch = (width + 3) & ~0x03;
+
+	/* the drawer reads one line past the bottom: keep it clear */
+	if (bitmap == NULL || ObjectSize(bitmap) < (int)sizeof(struct Bitmap) + pitch*(height + 1))
+	{
+		const int w = sprite->info->w;
+		const int h = sprite->info->h;
+		int size = (int)ceilf(sqrtf((float)(w*w + h*h))) + 2;
+
+		if (size < width + 3)
+			size = width + 3;
+		if (size < height + 1)
+			size = height + 1;
+
+		if (bitmap != NULL)
+			TLN_DeleteBitmap(bitmap);
+		bitmap = sprite->rotation_bitmap = TLN_CreateBitmap(size, size, 8);
+		if (bitmap == NULL)
+			return NULL;
+	}
+
+	bitmap->width = width;
+	bitmap->height = height;
+	bitmap->pitch = pitch;
+	memset(bitmap->data, 0, pitch*(height + 1));
+	return bitmap;
+}
+
 bool TLN_SetSpriteRotation(int nsprite, float angle)
 {
 	Sprite* sprite;
@@ -412,10 +451,6 @@ bool TLN_SetSpriteRotation(int nsprite, float angle)
 
 	sprite = &engine->sprites[nsprite];
 
-	/* borra anterior */
-	if (sprite->rotation_bitmap != NULL)
-		TLN_DeleteBitmap(sprite->rotation_bitmap);
-
 	/* calcula 4 esquinas */
 	spr_w = sprite->info->w;
 	spr_h = sprite->info->h;
@@ -467,7 +502,16 @@ bool TLN_SetSpriteRotation(int nsprite, float angle)
 		corners[c].y -= rect->y1;
 	}
 
-	rotated = TLN_CreateBitmap(rect->x2 - rect->x1 + 1, rect->y2 - rect->y1 + 1, 8);
+	/* reuses the bitmap of the previous rotation */
+	rotated = GetRotationBitmap(sprite, rect->x2 - rect->x1 + 1, rect->y2 - rect->y1 + 1);
+	if (rotated == NULL)
+	{
+		sprite->mode = MODE_NORMAL;
+		sprite->draw = GetSpriteDraw(sprite->mode);
+		MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT);
+		TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+		return false;
+	}
 
 	/* inicia vectores de barrido */
 	Vector2DSet(&xvect, &corners[0], &corners[1], spr_w);
@@ -490,9 +534,11 @@ bool TLN_SetSpriteRotation(int nsprite, float angle)
 		Vector2DAdvance(&yvect);
 	}
 
-	sprite->rotation_bitmap = rotated;
 	sprite->mode = MODE_TRANSFORM;
 	sprite->draw = GetSpriteDraw(sprite->mode);
+	/* queue before clearing RECT: an empty mask would append the sprite twice */
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_SCAN);
+	sprite->dirty &= ~SPRITE_DIRTY_RECT;	/* rectangle already computed above */
 
 	/* */
 	/*
@@ -515,12 +561,11 @@ bool TLN_ResetSpriteRotation(int nsprite)
 		return false;
 	}
 
+	/* the bitmap is kept for the next rotation */
 	sprite = &engine->sprites[nsprite]; 
-	if (sprite->rotation_bitmap != NULL)
-		TLN_DeleteBitmap(sprite->rotation_bitmap);
-
 	sprite->mode = MODE_NORMAL;
 	sprite->draw = GetSpriteDraw(sprite->mode);
+	MarkSpriteDirty (sprite, SPRITE_DIRTY_RECT);
 	return true;
 }
 
@@ -645,17 +690,268 @@ bool TLN_DisableSprite (int nsprite)
 	}	
 
 	engine->sprites[nsprite].ok = false;
+	MarkSpriteDirty (&engine->sprites[nsprite], SPRITE_DIRTY_SCAN);
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/* resets the drawing order to the sprite indexes */
+static void ResetSpriteOrder (void)
+{
+	int c;
+	for (c=0; c<engine->numsprites; c++)
+		engine->order.list[c] = c;
+}
+
+/*!
+ * \brief
+ * Sets the order in which sprites are drawn, independent of their indexes
+ * 
+ * \param order
+ * Array with the indexes of the sprites from back to front, or NULL to draw
+ * them in index order (default)
+ * 
+ * \param count
+ * Number of items in the array, up to the number of sprites
+ * 
+ * \remarks
+ * Sprites not listed in the array are drawn after the listed ones, in index order.
+ * The order stays until changed, and it disables sorting by key.
+ * 
+ * \see
+ * TLN_EnableSpriteSorting()
+ */
+bool TLN_SetSpriteDrawOrder (const int* order, int count)
+{
+	int* used = engine->order.tmp;
+	int c, n;
+
+	if (order == NULL)
+	{
+		engine->order.sort = false;
+		ResetSpriteOrder ();
+		TLN_SetLastError (TLN_ERR_OK);
+		return true;
+	}
+
+	/* validate the whole array before changing anything: indexes in range and not repeated */
+	if (count < 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+	if (count > engine->numsprites)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_SPRITE);
+		return false;
+	}
+	memset (used, 0, engine->numsprites * sizeof(int));
+	for (c=0; c<count; c++)
+	{
+		if (order[c] < 0 || order[c] >= engine->numsprites || used[order[c]])
+		{
+			TLN_SetLastError (TLN_ERR_IDX_SPRITE);
+			return false;
+		}
+		used[order[c]] = 1;
+	}
+
+	engine->order.sort = false;
+	memcpy (engine->order.list, order, count * sizeof(int));
+	for (c=0, n=count; c<engine->numsprites; c++)
+	{
+		if (!used[c])
+			engine->order.list[n++] = c;
+	}
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Sets the key used to sort a sprite when sorting is enabled
+ * 
+ * \param nsprite
+ * Id of the sprite [0, num_sprites - 1]
+ * 
+ * \param key
+ * Sort key, sprites with lower keys are drawn first. For example the y coordinate of the
+ * base of the sprite, in games with a top-down view
+ * 
+ * \see
+ * TLN_EnableSpriteSorting()
+ */
+bool TLN_SetSpriteSortKey (int nsprite, int key)
+{
+	if (nsprite >= engine->numsprites)
+	{
+		TLN_SetLastError (TLN_ERR_IDX_SPRITE);
+		return false;
+	}
+
+	engine->sprites[nsprite].sortkey = key;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Enables or disables sorting of sprites by key
+ * 
+ * \param enable
+ * true to sort sprites by their key at the start of each frame, false to draw them in index order
+ * 
+ * \remarks
+ * Sorting is stable: sprites with the same key are drawn in index order
+ * 
+ * \see
+ * TLN_SetSpriteSortKey(), TLN_SetSpriteDrawOrder()
+ */
+void TLN_EnableSpriteSorting (bool enable)
+{
+	engine->order.sort = enable;
+	if (!enable)
+		ResetSpriteOrder ();
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
+/*!
+ * \brief
+ * Limits the number of sprites drawn on each scanline, like classic sprite hardware
+ * 
+ * \param sprites
+ * Maximum number of sprites on a scanline, 0 for no limit (default)
+ * 
+ * \param pixels
+ * Maximum number of sprite pixels on a scanline, 0 for no limit (default)
+ * 
+ * \param mode
+ * Which sprites are dropped when a scanline is over the limit: SPRITE_LIMIT_DROP drops the
+ * ones at the back of the drawing order, SPRITE_LIMIT_ROTATE changes which ones are dropped
+ * on each frame so they flicker instead of vanishing
+ * 
+ * \remarks
+ * The limit bounds the worst-case time spent drawing sprites on a scanline. The number of
+ * sprite lines dropped in the last frame is returned by TLN_GetCulledSpriteLines()
+ * 
+ * \see
+ * TLN_GetCulledSpriteLines()
+ */
+bool TLN_SetSpriteLimit (int sprites, int pixels, TLN_SpriteLimit mode)
+{
+	if (sprites < 0 || pixels < 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	engine->spritelimit.sprites = sprites;
+	engine->spritelimit.pixels = pixels;
+	engine->spritelimit.mode = mode;
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
 }
 
+/*!
+ * \brief
+ * Returns the number of sprite lines dropped by the per-scanline limit in the last frame
+ * 
+ * \see
+ * TLN_SetSpriteLimit()
+ */
+int TLN_GetCulledSpriteLines (void)
+{
+	TLN_SetLastError (TLN_ERR_OK);
+	return engine->spritelimit.culled;
+}
+
+/* sorts the drawing order by key: stable LSD radix sort, one byte per pass */
+void SortSprites (void)
+{
+	const int numsprites = engine->numsprites;
+	int* src = engine->order.list;
+	int* dst = engine->order.tmp;
+	int count[256];
+	int shift;
+	int c;
+
+	if (numsprites == 0)
+		return;
+
+	ResetSpriteOrder ();
+	for (shift=0; shift<32; shift+=8)
+	{
+		int pos = 0;
+		int* tmp;
+
+		memset (count, 0, sizeof(count));
+		for (c=0; c<numsprites; c++)
+			count[(SortKey(engine->sprites[src[c]].sortkey) >> shift) & 0xFF]++;
+
+		/* all keys share this byte */
+		if (count[(SortKey(engine->sprites[src[0]].sortkey) >> shift) & 0xFF] == numsprites)
+			continue;
+
+		for (c=0; c<256; c++)
+		{
+			const int n = count[c];
+			count[c] = pos;
+			pos += n;
+		}
+		for (c=0; c<numsprites; c++)
+		{
+			const int nsprite = src[c];
+			dst[count[(SortKey(engine->sprites[nsprite].sortkey) >> shift) & 0xFF]++] = nsprite;
+		}
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	/* odd number of passes done */
+	if (src != engine->order.list)
+		memcpy (engine->order.list, src, numsprites * sizeof(int));
+}
+
+/* queues an update for the next UpdateDirtySprites() so that setters called
+ * many times per frame on the same sprite only pay for validation once */
+static void MarkSpriteDirty (Sprite* sprite, uint8_t what)
+{
+	if (!sprite->dirty)
+		engine->spritedirty.list[engine->spritedirty.count++] = (int)(sprite - engine->sprites);
+	sprite->dirty |= what;
+}
+
+/* applies pending sprite updates: at frame start and after raster callbacks */
+void UpdateDirtySprites (void)
+{
+	int c;
+
+	for (c=0; c<engine->spritedirty.count; c++)
+	{
+		Sprite* sprite = &engine->sprites[engine->spritedirty.list[c]];
+		if (sprite->dirty & SPRITE_DIRTY_RECT)
+			UpdateSprite (sprite);
+		else if (sprite->dirty & SPRITE_DIRTY_SCAN)
+			UpdateSpriteScan (sprite);
+		if (sprite->dirty & SPRITE_DIRTY_BLITTER)
+			SelectBlitter (sprite);
+		sprite->dirty = 0;
+	}
+	engine->spritedirty.count = 0;
+}
+
 /* actualiza datos internos */
 static void UpdateSprite (Sprite* sprite)
 {
 	int w,h;
 
 	if (!sprite->ok)
+	{
+		UpdateSpriteScan (sprite);
 		return;
+	}
 
 	if (sprite->sx > 1.0)
 		w = 0;
@@ -758,6 +1054,8 @@ static void UpdateSprite (Sprite* sprite)
 		}
 	}
 
+	UpdateSpriteScan (sprite);
+
 	/*
 	printf ("Sprite %02d scale=%.02f,%.02f src=[%d,%d,%d,%d] dst=[%d,%d,%d,%d]\n",
 		sprite->num, sprite->sx, sprite->sy,
@@ -766,6 +1064,54 @@ static void UpdateSprite (Sprite* sprite)
 	*/
 }
 
+/* copies the fields used by the scanline loop to the compact SpriteScan array */
+static void UpdateSpriteScan (Sprite* sprite)
+{
+	SpriteScan* scan = &engine->spritescan[sprite - engine->sprites];
+	int y1, y2;
+	int x1, x2;
+
+	scan->priority = (sprite->flags & FLAG_PRIORITY) != 0;
+	if (!sprite->ok)
+	{
+		scan->draw = NULL;
+		return;
+	}
+
+	/* vertical coverage, matching the checks done by the draw procedures */
+	if (sprite->mode == MODE_TRANSFORM)
+	{
+		y1 = sprite->y;
+		y2 = sprite->y + sprite->rotation_bitmap->height + 1;
+		if (y1 < 0)
+			y1 = 0;
+		if (y2 > engine->framebuffer.height)
+			y2 = engine->framebuffer.height;
+		x1 = sprite->x;
+		x2 = sprite->x + sprite->rotation_bitmap->width;
+	}
+	else if (sprite->dstrect.x2 < 0 || sprite->srcrect.x2 < 0)
+		y1 = y2 = x1 = x2 = 0;
+	else
+	{
+		y1 = sprite->dstrect.y1;
+		y2 = sprite->dstrect.y2;
+		x1 = sprite->dstrect.x1;
+		x2 = sprite->dstrect.x2;
+	}
+
+	/* horizontal coverage, clipped to the screen */
+	if (x1 < 0)
+		x1 = 0;
+	if (x2 > engine->framebuffer.width)
+		x2 = engine->framebuffer.width;
+
+	scan->draw = sprite->draw;
+	scan->y1 = (int16_t)y1;
+	scan->y2 = (int16_t)y2;
+	scan->width = (int16_t)(x2 > x1 ? x2 - x1 : 0);
+}
+
 static void SelectBlitter (Sprite* sprite)
 {
 	const bool scaling = sprite->mode == MODE_SCALING;
@@ -56,7 +56,28 @@ typedef struct Sprite
 	bool			do_collision;
 	bool			collision;
 	TLN_Bitmap		rotation_bitmap;
+	int				sortkey;	/* drawing order key when sorting is enabled */
+	uint8_t			dirty;		/* SPRITE_DIRTY_xxx updates pending until next frame */
 }
 Sprite;
 
+/* deferred updates, applied in batch by UpdateDirtySprites() */
+#define SPRITE_DIRTY_RECT		0x01	/* position/size changed: clip rectangles + scan */
+#define SPRITE_DIRTY_SCAN		0x02	/* flags/enable changed: scan only */
+#define SPRITE_DIRTY_BLITTER	0x04	/* blending/scaling changed: blitter */
+
+/* compact per-sprite data read by the scanline loop for every slot (hot),
+ * mirrored from Sprite (cold configuration) each time it changes */
+typedef struct
+{
+	ScanDrawPtr		draw;		/* draw procedure, NULL if sprite disabled */
+	int16_t			y1,y2;		/* vertical coverage on screen, empty if y1 >= y2 */
+	int16_t			width;		/* pixels covered on each line, for the per-line limit */
+	bool			priority;	/* FLAG_PRIORITY set */
+}
+SpriteScan;
+
+void SortSprites (void);
+void UpdateDirtySprites (void);
+
 #endif
\ No newline at end of file
@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "Tilengine.h"
 #include "Spriteset.h"
@@ -84,6 +85,8 @@ TLN_Spriteset TLN_CreateSpriteset (TLN_Bitmap bitmap, TLN_SpriteData* data, int
 			data++;
 		}
 	}
+	for (c=0; c<num_entries; c++)
+		spriteset->data[c].flipped = -1;
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return spriteset;
@@ -122,6 +125,7 @@ bool TLN_SetSpritesetData (TLN_Spriteset spriteset, int entry, TLN_SpriteData* d
 		return false;
 	}
 
+	DeleteFlippedSprites (spriteset);
 	set_sprite_entry (spriteset, entry, data);
 	if (pixels != NULL && pitch != 0)
 	{
@@ -161,6 +165,11 @@ TLN_Spriteset TLN_CloneSpriteset (TLN_Spriteset src)
 	spriteset = CloneBaseObject (src);
 	if (spriteset)
 	{
+		int c;
+		spriteset->flipped = NULL;
+		spriteset->size_flipped = spriteset->used_flipped = 0;
+		for (c=0; c<spriteset->entries; c++)
+			spriteset->data[c].flipped = -1;
 		TLN_SetLastError (TLN_ERR_OK);
 		return spriteset;
 	}
@@ -187,6 +196,7 @@ bool TLN_DeleteSpriteset (TLN_Spriteset spriteset)
 	{
 		if (ObjectOwner (spriteset))
 			DeleteBaseObject (spriteset->bitmap);
+		DeleteFlippedSprites (spriteset);
 		DeleteBaseObject (spriteset);
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
@@ -285,4 +295,62 @@ int TLN_FindSpritesetSprite (TLN_Spriteset spriteset, char* name)
 			return c;
 	}
 	return -1;
-}
\ No newline at end of file
+}
+
+/* returns the horizontally mirrored copy of a sprite, with pitch equal to its width. Copies are
+ * made on first use, so FLAG_FLIPX sprites are drawn forwards. NULL if there isn't memory for them */
+uint8_t* GetFlippedSprite (TLN_Spriteset spriteset, int entry)
+{
+	SpriteEntry* info = &spriteset->data[entry];
+	const uint8_t* src;
+	uint8_t* dst;
+	int x,y;
+
+	if (info->flipped >= 0)
+		return spriteset->flipped + info->flipped;
+
+	/* room for all the sprites, assigned in order of use */
+	if (spriteset->flipped == NULL)
+	{
+		int size = 0;
+		int c;
+
+		for (c=0; c<spriteset->entries; c++)
+			size += spriteset->data[c].w * spriteset->data[c].h;
+		spriteset->flipped = malloc (size);
+		if (spriteset->flipped == NULL)
+			return NULL;
+		spriteset->size_flipped = size;
+		spriteset->used_flipped = 0;
+		AddObjectMemory (size);
+	}
+
+	info->flipped = spriteset->used_flipped;
+	spriteset->used_flipped += info->w * info->h;
+	src = spriteset->bitmap->data + info->offset;
+	dst = spriteset->flipped + info->flipped;
+	for (y=0; y<info->h; y++)
+	{
+		for (x=0; x<info->w; x++)
+			dst[x] = src[info->w - x - 1];
+		src += spriteset->bitmap->pitch;
+		dst += info->w;
+	}
+	return spriteset->flipped + info->flipped;
+}
+
+/* frees the mirrored sprites */
+void DeleteFlippedSprites (TLN_Spriteset spriteset)
+{
+	int c;
+
+	if (spriteset->flipped == NULL)
+		return;
+
+	AddObjectMemory (-spriteset->size_flipped);
+	free (spriteset->flipped);
+	spriteset->flipped = NULL;
+	spriteset->size_flipped = spriteset->used_flipped = 0;
+	for (c=0; c<spriteset->entries; c++)
+		spriteset->data[c].flipped = -1;
+}
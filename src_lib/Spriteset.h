@@ -30,6 +30,7 @@ typedef struct
 	hash_t hash;
 	int w,h;
 	int offset;
+	int flipped;	/* offset of the mirrored copy in Spriteset.flipped, -1 if not made */
 }
 SpriteEntry;
 
@@ -39,9 +40,14 @@ struct Spriteset
 	int entries;
 	TLN_Bitmap bitmap;
 	TLN_Palette palette;
+	uint8_t* flipped;	/* horizontally mirrored sprites, NULL until first needed */
+	int size_flipped;	/* bytes allocated in flipped */
+	int used_flipped;	/* bytes used in flipped */
 	SpriteEntry data[];
 };
 
 TLN_SpriteInfo* GetSpriteInfo (TLN_Spriteset spriteset, int entry);
+uint8_t* GetFlippedSprite (TLN_Spriteset spriteset, int entry);
+void DeleteFlippedSprites (TLN_Spriteset spriteset);
 
 #endif
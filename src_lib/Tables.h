@@ -26,4 +26,8 @@ uint8_t* SelectBlendTable (TLN_Blend mode);
 
 #define blendfunc(t,a,b) *(t  + ((a)<<8) + (b))
 
+/* alpha of a blended pixel: coverage of an opaque color blended over it, never lower than the current one */
+#define blendalpha(t,a) \
+	((a) == 0xFF || blendfunc(t,0xFF,a) < (a) ? (a) : blendfunc(t,0xFF,a))
+
 #endif
@@ -0,0 +1,201 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+ * \file tilecache.c
+ * Cache of tiles resolved to 32 bpp with a given palette
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "TileCache.h"
+#include "Tileset.h"
+#include "Palette.h"
+
+#define NO_ENTRY	-1
+
+/* private prototypes */
+static void Unlink (TileCache* cache, int e);
+static void LinkFirst (TileCache* cache, int e);
+
+/* creates cache with the given number of tiles */
+TileCache* CreateTileCache (int count)
+{
+	TileCache* cache;
+	int buckets = 1;
+	int c;
+
+	/* hash table with at least twice as buckets as entries */
+	while (buckets < count*2)
+		buckets <<= 1;
+
+	cache = calloc (1, sizeof(TileCache));
+	if (cache == NULL)
+		return NULL;
+
+	cache->count = count;
+	cache->mask = buckets - 1;
+	cache->buckets = malloc (buckets * sizeof(int));
+	cache->entries = calloc (count, sizeof(TileCacheEntry));
+	CountAllocation (sizeof(TileCache) + buckets * sizeof(int) + count * sizeof(TileCacheEntry));
+	if (cache->buckets == NULL || cache->entries == NULL)
+	{
+		DeleteTileCache (cache);
+		return NULL;
+	}
+
+	for (c=0; c<buckets; c++)
+		cache->buckets[c] = NO_ENTRY;
+
+	/* all entries free, chained in order */
+	for (c=0; c<count; c++)
+	{
+		cache->entries[c].prev = c - 1;
+		cache->entries[c].next = c + 1;
+		cache->entries[c].chain = NO_ENTRY;
+	}
+	cache->entries[count - 1].next = NO_ENTRY;
+	cache->head = 0;
+	cache->tail = count - 1;
+	return cache;
+}
+
+/* frees cache and its resolved tiles */
+void DeleteTileCache (TileCache* cache)
+{
+	int c;
+
+	if (cache == NULL)
+		return;
+
+	if (cache->entries)
+	{
+		for (c=0; c<cache->count; c++)
+			free (cache->entries[c].data);
+		free (cache->entries);
+	}
+	free (cache->buckets);
+	free (cache);
+}
+
+static int GetBucket (TileCache* cache, uint32_t tileset, int index, uint32_t palette)
+{
+	uint32_t hash = tileset*2654435761u ^ (uint32_t)index*40503u ^ palette*2246822519u;
+	return (int)((hash ^ (hash >> 16)) & cache->mask);
+}
+
+/*!
+ * \brief Returns a line of the given tile resolved to 32 bpp with the given palette. The tile
+ * is resolved on cache miss, replacing the least recently used entry.
+ */
+uint32_t* GetTileCacheLine (TileCache* cache, TLN_Tileset tileset, int index, TLN_Palette palette, int y)
+{
+	const int bucket = GetBucket (cache, tileset->version, index, palette->version);
+	TileCacheEntry* entry;
+	int e;
+
+	/* hit */
+	for (e=cache->buckets[bucket]; e!=NO_ENTRY; e=cache->entries[e].chain)
+	{
+		entry = &cache->entries[e];
+		if (entry->index == index && entry->tileset == tileset->version && entry->palette == palette->version)
+		{
+			if (e != cache->head)
+			{
+				Unlink (cache, e);
+				LinkFirst (cache, e);
+			}
+			return entry->data + (y << tileset->hshift);
+		}
+	}
+
+	/* miss: recycle least recently used entry */
+	e = cache->tail;
+	entry = &cache->entries[e];
+	if (entry->index != 0)
+	{
+		const int old = GetBucket (cache, entry->tileset, entry->index, entry->palette);
+		int* link = &cache->buckets[old];
+		while (*link != e)
+			link = &cache->entries[*link].chain;
+		*link = entry->chain;
+	}
+
+	/* resolve tile */
+	{
+		const int size = tileset->width * tileset->height;
+		const uint32_t* colors = (uint32_t*)palette->data;
+		const uint8_t* srcpixel = &GetTilesetPixel (tileset, GetResidentTile (tileset, index), 0, 0);
+		int c;
+
+		if (entry->capacity < size)
+		{
+			uint32_t* data = realloc (entry->data, size * sizeof(uint32_t));
+			CountAllocation (size * sizeof(uint32_t));
+			if (data == NULL)
+			{
+				entry->index = 0;
+				return NULL;
+			}
+			entry->data = data;
+			entry->capacity = size;
+		}
+		for (c=0; c<size; c++)
+			entry->data[c] = colors[srcpixel[c]];
+	}
+
+	entry->tileset = tileset->version;
+	entry->palette = palette->version;
+	entry->index = index;
+	entry->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = e;
+	Unlink (cache, e);
+	LinkFirst (cache, e);
+	return entry->data + (y << tileset->hshift);
+}
+
+/* removes entry from LRU list */
+static void Unlink (TileCache* cache, int e)
+{
+	TileCacheEntry* entry = &cache->entries[e];
+
+	if (entry->prev != NO_ENTRY)
+		cache->entries[entry->prev].next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if (entry->next != NO_ENTRY)
+		cache->entries[entry->next].prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+}
+
+/* inserts entry as most recently used */
+static void LinkFirst (TileCache* cache, int e)
+{
+	TileCacheEntry* entry = &cache->entries[e];
+
+	entry->prev = NO_ENTRY;
+	entry->next = cache->head;
+	if (cache->head != NO_ENTRY)
+		cache->entries[cache->head].prev = e;
+	else
+		cache->tail = e;
+	cache->head = e;
+}
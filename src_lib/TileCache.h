@@ -0,0 +1,53 @@
+/*
+* Tilengine - The 2D retro graphics engine with raster effects
+* Copyright (C) 2015-2018 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+* All rights reserved
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TILECACHE_H
+#define _TILECACHE_H
+
+#include "Tilengine.h"
+
+/* tile resolved to 32 bpp with a given palette */
+typedef struct
+{
+	uint32_t	tileset;	/* tileset version */
+	uint32_t	palette;	/* palette version */
+	int			index;		/* tile index, 0 = free entry */
+	int			prev, next;	/* LRU list, most recently used first */
+	int			chain;		/* next entry in same hash bucket */
+	int			capacity;	/* allocated pixels in data */
+	uint32_t*	data;		/* resolved pixels */
+}
+TileCacheEntry;
+
+/* LRU cache of resolved tiles */
+typedef struct
+{
+	int			count;		/* number of entries */
+	int			mask;		/* number of hash buckets - 1 */
+	int			head, tail;	/* most and least recently used entries */
+	int*		buckets;	/* first entry of each hash bucket, -1 if empty */
+	TileCacheEntry* entries;
+}
+TileCache;
+
+TileCache* CreateTileCache (int count);
+void DeleteTileCache (TileCache* cache);
+uint32_t* GetTileCacheLine (TileCache* cache, TLN_Tileset tileset, int index, TLN_Palette palette, int y);
+
+#endif
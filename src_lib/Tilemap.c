@@ -28,6 +28,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "Tilengine.h"
 #include "Tilemap.h"
 
@@ -37,6 +38,16 @@ typedef struct
 }
 Rect;
 
+#define OCCUPANCY_WORDS(cols)	(((cols) + 31) >> 5)
+
+/* blocked layout: 4x4 tiles, one cache line (see GetBlockedTile) */
+#define BLOCK_SIZE	4
+#define BLOCKS(n)	(((n) + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+static void SetupOccupancy (TLN_Tilemap tilemap);
+static void SetTileOccupancy (TLN_Tilemap tilemap, int row, int col, bool occupied);
+static void UpdateBlockedTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols);
+
 /*!
  * \brief
  * Creates a new tilemap
@@ -70,6 +81,10 @@ TLN_Tilemap TLN_CreateTilemap (int rows, int cols, TLN_Tile tiles, uint32_t bgco
 	TLN_Tilemap tilemap = NULL;
 	int size = sizeof(struct Tilemap) + (rows * cols * sizeof(struct Tile));
 
+	/* occupancy bitmaps and row counters go after the tiles */
+	size += rows * OCCUPANCY_WORDS(cols) * sizeof(uint32_t);
+	size += rows * sizeof(int);
+
 	tilemap = CreateBaseObject (OT_TILEMAP, size);
 	if (!tilemap)
 		return NULL;
@@ -78,9 +93,13 @@ TLN_Tilemap TLN_CreateTilemap (int rows, int cols, TLN_Tile tiles, uint32_t bgco
 	tilemap->cols = cols;
 	tilemap->bgcolor = bgcolor;
 	tilemap->tileset = tileset;
+	SetupOccupancy (tilemap);
 
 	if (tiles)
-		memcpy (tilemap->tiles, tiles, tilemap->size - sizeof(struct Tilemap));
+	{
+		memcpy (tilemap->tiles, tiles, rows * cols * sizeof(struct Tile));
+		UpdateTilemapOccupancy (tilemap);
+	}
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return tilemap;
@@ -109,6 +128,9 @@ TLN_Tilemap TLN_CloneTilemap (TLN_Tilemap src)
 	tilemap = CloneBaseObject (src);
 	if (tilemap)
 	{
+		SetupOccupancy (tilemap);
+		tilemap->numdirty = 0;
+		tilemap->blocked = NULL;
 		TLN_SetLastError (TLN_ERR_OK);
 		return tilemap;
 	}
@@ -255,6 +277,8 @@ bool TLN_SetTilemapTile (TLN_Tilemap tilemap, int row, int col, TLN_Tile tile)
 			dsttile->index = tile->index;
 			if (tilemap->maxindex < tile->index)
 				tilemap->maxindex = tile->index;
+			SetTileOccupancy (tilemap, row, col, tile->index != 0);
+			AddTilemapDirtyRect (tilemap, row, col, 1, 1);
 
 			TLN_SetLastError (TLN_ERR_OK);
 			return true;
@@ -286,8 +310,9 @@ bool TLN_DeleteTilemap (TLN_Tilemap tilemap)
 {
 	if (CheckBaseObject (tilemap, OT_TILEMAP))
 	{
-		if (ObjectOwner (tilemap))
-			DeleteBaseObject (tilemap->tileset);
+		if (ObjectOwner (tilemap) && tilemap->tileset != NULL)
+			TLN_DeleteTileset (tilemap->tileset);
+		DeleteBlockedTilemap (tilemap);
 		DeleteBaseObject (tilemap);
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
@@ -345,11 +370,13 @@ bool TLN_CopyTiles (TLN_Tilemap src, int srcrow, int srccol, int rows, int cols,
 	/* setup rects */
 	{
 		Rect tgtrect = {srccol,srcrow, cols,rows};	/* area a copiar */
-		Rect srcrect = {0,0, src->rows,src->cols};	/* tilemap de origen */
-		Rect dstrect = {0,0, dst->rows,dst->cols};	/* tilemap de destino */
+		Rect srcrect = {0,0, src->cols,src->rows};	/* tilemap de origen */
+		Rect dstrect = {0,0, dst->cols,dst->rows};	/* tilemap de destino */
 
 		/* clipping */
 		ClipRect (&tgtrect, &srcrect);
+		tgtrect.x = dstcol;
+		tgtrect.y = dstrow;
 		ClipRect (&tgtrect, &dstrect);
 
 		size = tgtrect.w * sizeof(Tile);
@@ -358,15 +385,430 @@ bool TLN_CopyTiles (TLN_Tilemap src, int srcrow, int srccol, int rows, int cols,
 			Tile* srctile = GetTilemapPtr (src, y + srcrow, srccol);
 			Tile* dsttile = GetTilemapPtr (dst, y + dstrow, dstcol);
 			if (srctile && dsttile)
+			{
+				int c = (int)(dsttile - dst->tiles);
+				int x;
 				memcpy (dsttile, srctile, size);
+				for (x=0; x<tgtrect.w; x++, c++)
+					SetTileOccupancy (dst, c / dst->cols, c % dst->cols, dsttile[x].index != 0);
+			}
 			else
 			{
 				TLN_SetLastError (TLN_ERR_WRONG_SIZE);
 				return false;
 			}
 		}
+		AddTilemapDirtyRect (dst, dstrow, dstcol, tgtrect.h, tgtrect.w);
+	}
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/* checks that a block of tiles is inside the tilemap */
+static bool CheckTilemapRegion (TLN_Tilemap tilemap, int row, int col, int rows, int cols)
+{
+	if (row < 0 || col < 0 || rows < 0 || cols < 0 ||
+		row + rows > tilemap->rows || col + cols > tilemap->cols)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+	return true;
+}
+
+/* writes a block of tiles, skipping empty source tiles when masked */
+static bool WriteTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, const Tile* tiles, int pitch, int step, bool masked)
+{
+	int y, x;
+
+	if (!CheckBaseObject (tilemap, OT_TILEMAP))
+		return false;
+	if (tiles == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_NULL_POINTER);
+		return false;
+	}
+	if (!CheckTilemapRegion (tilemap, row, col, rows, cols))
+		return false;
+
+	for (y=0; y<rows; y++)
+	{
+		const Tile* srctile = &tiles[y*pitch];
+		Tile* dsttile = &tilemap->tiles[(row + y)*tilemap->cols + col];
+
+		for (x=0; x<cols; x++, srctile+=step, dsttile++)
+		{
+			if (masked && srctile->index == 0)
+				continue;
+			*dsttile = *srctile;
+			if (tilemap->maxindex < srctile->index)
+				tilemap->maxindex = srctile->index;
+			SetTileOccupancy (tilemap, row + y, col + x, srctile->index != 0);
+		}
+	}
+	AddTilemapDirtyRect (tilemap, row, col, rows, cols);
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Sets a rectangular block of tiles of a tilemap in one call
+ * 
+ * \param tilemap
+ * Reference to the tilemap
+ * 
+ * \param row
+ * First row of the block inside the tilemap
+ * 
+ * \param col
+ * First column of the block inside the tilemap
+ * 
+ * \param rows
+ * Number of rows of the block
+ * 
+ * \param cols
+ * Number of columns of the block
+ * 
+ * \param tiles
+ * Array with the source tiles, row after row
+ * 
+ * \param pitch
+ * Number of tiles between the start of consecutive rows in the source array
+ * 
+ * \returns
+ * true (success) or false (error)
+ * 
+ * \remarks
+ * The block must fit inside the tilemap. It is recorded as a dirty rectangle
+ * 
+ * \see
+ * TLN_StampTilemapTiles(), TLN_FillTilemapTiles(), TLN_GetTilemapDirtyRects()
+ */
+bool TLN_SetTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, const Tile* tiles, int pitch)
+{
+	return WriteTiles (tilemap, row, col, rows, cols, tiles, pitch, 1, false);
+}
+
+/*!
+ * \brief
+ * Sets a rectangular block of tiles of a tilemap, leaving unchanged the cells where the source tile is empty
+ * 
+ * \param tilemap
+ * Reference to the tilemap
+ * 
+ * \param row
+ * First row of the block inside the tilemap
+ * 
+ * \param col
+ * First column of the block inside the tilemap
+ * 
+ * \param rows
+ * Number of rows of the block
+ * 
+ * \param cols
+ * Number of columns of the block
+ * 
+ * \param tiles
+ * Array with the source tiles, row after row. Tiles with index 0 aren't written
+ * 
+ * \param pitch
+ * Number of tiles between the start of consecutive rows in the source array
+ * 
+ * \returns
+ * true (success) or false (error)
+ * 
+ * \see
+ * TLN_SetTilemapTiles()
+ */
+bool TLN_StampTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, const Tile* tiles, int pitch)
+{
+	return WriteTiles (tilemap, row, col, rows, cols, tiles, pitch, 1, true);
+}
+
+/*!
+ * \brief
+ * Fills a rectangular block of a tilemap with the same tile
+ * 
+ * \param tilemap
+ * Reference to the tilemap
+ * 
+ * \param row
+ * First row of the block inside the tilemap
+ * 
+ * \param col
+ * First column of the block inside the tilemap
+ * 
+ * \param rows
+ * Number of rows of the block
+ * 
+ * \param cols
+ * Number of columns of the block
+ * 
+ * \param tile
+ * Reference to the tile to write
+ * 
+ * \returns
+ * true (success) or false (error)
+ * 
+ * \see
+ * TLN_SetTilemapTiles()
+ */
+bool TLN_FillTilemapTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols, TLN_Tile tile)
+{
+	return WriteTiles (tilemap, row, col, rows, cols, tile, 0, 0, false);
+}
+
+/*!
+ * \brief
+ * Gets the areas of a tilemap modified since the dirty rectangles were last cleared
+ * 
+ * \param tilemap
+ * Reference to the tilemap
+ * 
+ * \param rects
+ * Array that receives the dirty rectangles, can be NULL to just get the count
+ * 
+ * \param maxrects
+ * Number of items in the rects array
+ * 
+ * \returns
+ * Number of dirty rectangles, or -1 if error
+ * 
+ * \remarks
+ * All writes through the tilemap API are recorded: single tiles, blocks and copies. When too
+ * many areas are modified they are merged into their bounding rectangle, so consumers like
+ * incremental caches can update only the changed area
+ * 
+ * \see
+ * TLN_ClearTilemapDirtyRects()
+ */
+int TLN_GetTilemapDirtyRects (TLN_Tilemap tilemap, TLN_TileRect* rects, int maxrects)
+{
+	if (!CheckBaseObject (tilemap, OT_TILEMAP))
+		return -1;
+
+	if (rects != NULL)
+	{
+		const int count = tilemap->numdirty < maxrects ? tilemap->numdirty : maxrects;
+		memcpy (rects, tilemap->dirty, count * sizeof(TLN_TileRect));
 	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return tilemap->numdirty;
+}
+
+/*!
+ * \brief
+ * Clears the dirty rectangles of a tilemap, after the changes have been processed
+ * 
+ * \param tilemap
+ * Reference to the tilemap
+ * 
+ * \see
+ * TLN_GetTilemapDirtyRects()
+ */
+bool TLN_ClearTilemapDirtyRects (TLN_Tilemap tilemap)
+{
+	if (!CheckBaseObject (tilemap, OT_TILEMAP))
+		return false;
 
+	tilemap->numdirty = 0;
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
 }
+
+/* records a modified area, merging all of them when the list is full */
+void AddTilemapDirtyRect (TLN_Tilemap tilemap, int row, int col, int rows, int cols)
+{
+	TLN_TileRect* rect;
+	int x2 = col + cols;
+	int y2 = row + rows;
+	int c;
+
+	if (rows <= 0 || cols <= 0)
+		return;
+
+	if (tilemap->blocked != NULL)
+		UpdateBlockedTiles (tilemap, row, col, rows, cols);
+
+	/* already covered */
+	for (c=0; c<tilemap->numdirty; c++)
+	{
+		rect = &tilemap->dirty[c];
+		if (row >= rect->row && col >= rect->col && y2 <= rect->row + rect->rows && x2 <= rect->col + rect->cols)
+			return;
+	}
+
+	if (tilemap->numdirty < MAX_DIRTY_RECTS)
+	{
+		rect = &tilemap->dirty[tilemap->numdirty++];
+		rect->row = row;
+		rect->col = col;
+		rect->rows = rows;
+		rect->cols = cols;
+		return;
+	}
+
+	/* full: bounding rectangle of all */
+	for (c=0; c<tilemap->numdirty; c++)
+	{
+		rect = &tilemap->dirty[c];
+		if (rect->row < row)
+			row = rect->row;
+		if (rect->col < col)
+			col = rect->col;
+		if (rect->row + rect->rows > y2)
+			y2 = rect->row + rect->rows;
+		if (rect->col + rect->cols > x2)
+			x2 = rect->col + rect->cols;
+	}
+	rect = &tilemap->dirty[0];
+	rect->row = row;
+	rect->col = col;
+	rect->rows = y2 - row;
+	rect->cols = x2 - col;
+	tilemap->numdirty = 1;
+}
+
+/* copies a rectangle of tiles to the blocked layout */
+static void UpdateBlockedTiles (TLN_Tilemap tilemap, int row, int col, int rows, int cols)
+{
+	Tile* blocked = tilemap->blocked;
+	int x,y;
+
+	for (y=row; y<row + rows; y++)
+	{
+		const Tile* src = &tilemap->tiles[y*tilemap->cols];
+		for (x=col; x<col + cols; x++)
+			*GetBlockedTile (blocked, tilemap->blockpitch, y, x) = src[x];
+	}
+}
+
+/* returns a copy of the tiles arranged in blocks of 4x4 tiles, so a diagonal walk through the map
+ * stays longer inside each cache line. Made on first use and kept up to date by the functions that
+ * write tiles. Use with GetBlockedTile(). NULL if there isn't memory for the copy */
+Tile* GetBlockedTilemap (TLN_Tilemap tilemap)
+{
+	int size;
+
+	if (tilemap->blocked != NULL)
+		return tilemap->blocked;
+
+	tilemap->blockpitch = BLOCKS(tilemap->cols) * BLOCK_SIZE * BLOCK_SIZE;
+	size = BLOCKS(tilemap->rows) * tilemap->blockpitch * sizeof(Tile);
+	tilemap->blocked = malloc (size);
+	if (tilemap->blocked == NULL)
+		return NULL;
+
+	AddObjectMemory (size);
+	UpdateBlockedTiles (tilemap, 0, 0, tilemap->rows, tilemap->cols);
+	return tilemap->blocked;
+}
+
+/* frees the blocked tiles */
+void DeleteBlockedTilemap (TLN_Tilemap tilemap)
+{
+	if (tilemap->blocked == NULL)
+		return;
+
+	AddObjectMemory (-(int)(BLOCKS(tilemap->rows) * tilemap->blockpitch * sizeof(Tile)));
+	free (tilemap->blocked);
+	tilemap->blocked = NULL;
+}
+
+/* sets occupancy pointers after the tiles array (on creation and after cloning) */
+static void SetupOccupancy (TLN_Tilemap tilemap)
+{
+	tilemap->occupancy = (uint32_t*)&tilemap->tiles[tilemap->rows * tilemap->cols];
+	tilemap->rowcount = (int*)&tilemap->occupancy[tilemap->rows * OCCUPANCY_WORDS(tilemap->cols)];
+}
+
+/* updates occupancy bit and row counter of a single cell */
+static void SetTileOccupancy (TLN_Tilemap tilemap, int row, int col, bool occupied)
+{
+	uint32_t* word = &tilemap->occupancy[row * OCCUPANCY_WORDS(tilemap->cols) + (col >> 5)];
+	const uint32_t mask = 1u << (col & 31);
+
+	if (occupied && !(*word & mask))
+	{
+		*word |= mask;
+		tilemap->rowcount[row]++;
+	}
+	else if (!occupied && (*word & mask))
+	{
+		*word &= ~mask;
+		tilemap->rowcount[row]--;
+	}
+}
+
+/* rebuilds occupancy bitmaps of the whole tilemap after tiles are written directly */
+void UpdateTilemapOccupancy (TLN_Tilemap tilemap)
+{
+	const int words = OCCUPANCY_WORDS(tilemap->cols);
+	const Tile* tile = tilemap->tiles;
+	int row, col;
+
+	memset (tilemap->occupancy, 0, tilemap->rows * words * sizeof(uint32_t));
+	for (row=0; row<tilemap->rows; row++)
+	{
+		uint32_t* bits = &tilemap->occupancy[row * words];
+		int count = 0;
+		for (col=0; col<tilemap->cols; col++, tile++)
+		{
+			if (tile->index)
+			{
+				bits[col >> 5] |= 1u << (col & 31);
+				count++;
+			}
+		}
+		tilemap->rowcount[row] = count;
+	}
+}
+
+/* index of lowest bit set, word must be non-zero */
+static int LowestBit (uint32_t word)
+{
+#ifdef __GNUC__
+	return __builtin_ctz (word);
+#else
+	int bit = 0;
+	while (!(word & 1))
+	{
+		word >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/* first occupied column in [start, end), or end if none */
+static int FindOccupiedColumn (const uint32_t* bits, int start, int end)
+{
+	while (start < end)
+	{
+		const uint32_t word = bits[start >> 5] >> (start & 31);
+		if (word)
+		{
+			start += LowestBit (word);
+			return start < end ? start : end;
+		}
+		start = (start | 31) + 1;
+	}
+	return end;
+}
+
+/*!
+ * \brief Returns the number of consecutive empty tiles in a row starting at the given column,
+ * wrapping around the right edge. The row must contain at least one non-empty tile.
+ */
+int GetTilemapEmptyRun (const struct Tilemap* tilemap, int row, int col)
+{
+	const uint32_t* bits = &tilemap->occupancy[row * OCCUPANCY_WORDS(tilemap->cols)];
+	int end = FindOccupiedColumn (bits, col, tilemap->cols);
+
+	if (end < tilemap->cols)
+		return end - col;
+	return tilemap->cols - col + FindOccupiedColumn (bits, 0, col);
+}
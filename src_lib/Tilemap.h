@@ -23,6 +23,8 @@
 #include "Object.h"
 #include "Tileset.h"
 
+#define MAX_DIRTY_RECTS	8
+
 /* mapa */
 struct Tilemap
 {
@@ -32,7 +34,22 @@ struct Tilemap
 	int		maxindex;	/* n de tile ms alto */
 	int		bgcolor;	/* color de fondo */
 	struct Tileset* tileset; /* tileset asociado (si hay) */
+	uint32_t* occupancy;/* bitmap of non-empty tiles, one bit per column and (cols+31)/32 words per row */
+	int*	rowcount;	/* number of non-empty tiles in each row */
+	int		numdirty;	/* number of dirty rectangles */
+	TLN_TileRect dirty[MAX_DIRTY_RECTS];	/* areas modified since last cleared */
+	Tile*	blocked;	/* copy of the tiles in 4x4 blocks, NULL until first needed */
+	int		blockpitch;	/* tiles in each row of blocks */
 	Tile	tiles[];
 };
 
+void UpdateTilemapOccupancy (struct Tilemap* tilemap);
+int GetTilemapEmptyRun (const struct Tilemap* tilemap, int row, int col);
+void AddTilemapDirtyRect (struct Tilemap* tilemap, int row, int col, int rows, int cols);
+Tile* GetBlockedTilemap (struct Tilemap* tilemap);
+void DeleteBlockedTilemap (struct Tilemap* tilemap);
+
+#define GetBlockedTile(blocked,pitch,row,col) \
+	(&(blocked)[((row) >> 2)*(pitch) + (((col) >> 2) << 4) + (((row) & 3) << 2) + ((col) & 3)])
+
 #endif
@@ -115,11 +115,25 @@ static TLN_Engine create_context(int hres, int vres, int bpp, int numlayers, int
 		return NULL;
 	}
 	for (c=0; c<context->numlayers; c++)
+	{
 		context->layers[c].mosaic.buffer = malloc (hres);
+		context->layers[c].lowres.buffer = malloc (hres*2*sizeof(uint32_t) + (hres + 1)*2);
+		context->layers[c].lowres.x = context->layers[c].lowres.y = 1;
+		if (!context->layers[c].mosaic.buffer || !context->layers[c].lowres.buffer)
+		{
+			TLN_DeleteContext(context);
+			TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+			return NULL;
+		}
+	}
 
 	context->numsprites = numsprites;
 	context->sprites = calloc (numsprites, sizeof(Sprite));
-	if (!context->sprites)
+	context->spritescan = calloc (numsprites, sizeof(SpriteScan));
+	context->order.list = malloc (numsprites * 2 * sizeof(int));
+	context->spritelimit.list = malloc (numsprites * sizeof(int));
+	context->spritedirty.list = malloc (numsprites * sizeof(int));
+	if (!context->sprites || !context->spritescan || !context->order.list || !context->spritelimit.list || !context->spritedirty.list)
 	{
 		TLN_DeleteContext(context);
 		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
@@ -130,11 +144,14 @@ static TLN_Engine create_context(int hres, int vres, int bpp, int numlayers, int
 		context->sprites[c].draw = GetSpriteDraw (MODE_NORMAL);
 		context->sprites[c].blitter = GetBlitter (bpp, true, false, false);
 		context->sprites[c].sx = context->sprites[c].sy = 1.0f;
+		context->order.list[c] = c;
 	}
+	context->order.tmp = context->order.list + numsprites;
 
 	context->numanimations = numanimations;
 	context->animations = calloc (numanimations, sizeof(Animation));
-	if (!context->animations)
+	context->animpool = CreateAnimationPool (context->animations, numanimations);
+	if (!context->animations || (numanimations > 0 && !context->animpool))
 	{
 		TLN_DeleteContext(context);
 		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
@@ -235,10 +252,33 @@ bool TLN_DeleteContext(TLN_Engine context)
 	DeleteBlendTables ();
 
 	for (c=0; c<engine->numlayers; c++)
+	{
 		free (engine->layers[c].mosaic.buffer);
+		free (engine->layers[c].lowres.buffer);
+		ReleaseLayerText (&engine->layers[c]);
+	}
 
 	if (engine->sprites)
+	{
+		for (c=0; c<engine->numsprites; c++)
+		{
+			if (engine->sprites[c].rotation_bitmap != NULL)
+				TLN_DeleteBitmap (engine->sprites[c].rotation_bitmap);
+		}
 		free (engine->sprites);
+	}
+
+	if (engine->spritescan)
+		free (engine->spritescan);
+
+	if (engine->order.list)
+		free (engine->order.list);
+
+	if (engine->spritelimit.list)
+		free (engine->spritelimit.list);
+
+	if (engine->spritedirty.list)
+		free (engine->spritedirty.list);
 
 	if (engine->layers)
 		free (engine->layers);
@@ -249,12 +289,27 @@ bool TLN_DeleteContext(TLN_Engine context)
 	if (engine->animations)
 		free (engine->animations);
 
+	if (engine->animpool)
+		free (engine->animpool);
+
 	if (engine->collision)
 		free (engine->collision);
 
 	if (engine->tmpindex)
 		free (engine->tmpindex);
 
+	if (engine->interrupts.list)
+		free (engine->interrupts.list);
+
+	free (engine->ids.buffer);
+	free (engine->ids.priority);
+
+	DeleteTileCache (engine->tilecache);
+
+	TLN_SetColorLUT (NULL, 0);
+	DeleteLightMap ();
+	DeleteRasterProgram ();
+
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
 }
@@ -415,8 +470,14 @@ void TLN_BeginFrame (int time)
 {
 	int c;
 
+	/* allocations are counted per frame, and enforced from the first frame after setting the policy */
+	engine->allocs.count = 0;
+	engine->allocs.armed = engine->allocs.policy != ALLOC_ALLOW;
+
 	UpdateAnimations (time);
 	engine->line = 0;
+	engine->program.time = time;
+	engine->interrupts.next = 0;
 
 	/* limpia colisiones de sprites */
 	for (c=0; c<engine->numsprites; c++)
@@ -425,6 +486,32 @@ void TLN_BeginFrame (int time)
 	/* frame callback */
 	if (engine->frame)
 		engine->frame (time);
+
+	/* text written since last frame */
+	for (c=0; c<engine->numlayers; c++)
+	{
+		if (engine->layers[c].text.update)
+			UpdateLayerText (&engine->layers[c]);
+	}
+
+	/* tiles of virtual tilesets about to scroll into view */
+	for (c=0; c<engine->numlayers; c++)
+	{
+		Layer* layer = &engine->layers[c];
+		if (layer->ok && layer->tilemap != NULL && layer->tileset != NULL && layer->tileset->resident != NULL)
+			PrefetchLayerTiles (layer);
+	}
+
+	/* sprites modified since last frame */
+	UpdateDirtySprites ();
+
+	/* sprite keys set by the application */
+	if (engine->order.sort)
+		SortSprites ();
+
+	/* per-line sprite limit: new count, next rotation */
+	engine->spritelimit.culled = 0;
+	engine->spritelimit.phase++;
 }
 
 /*!
@@ -475,6 +562,73 @@ void TLN_SetRasterCallback (void (*callback)(int))
 	engine->raster = callback;
 }
 
+/*!
+ * \brief
+ * Restricts raster processing to a list of scanlines
+ * 
+ * \param interrupts
+ * Array of TLN_RasterInterrupt items, in any order. Set NULL to call the raster callback on every line again
+ * 
+ * \param count
+ * Number of items in the array
+ * 
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Most raster effects only change the rendering parameters at a few scanlines: a status bar
+ * split, a water line, a horizon... Registered interrupts mimic the line compare interrupt of
+ * the classic video chips: only the listed lines call their callback, or the raster callback set
+ * with TLN_SetRasterCallback() when the item callback is NULL, and the remaining lines are drawn
+ * without any call. The list is copied, so the array can be released after the call. It can be
+ * called from an interrupt callback to re-arm the line compare: the new list takes effect at the
+ * lines below the current one, and the buffer of the previous list is reused when it's big enough.
+ * This is specially useful from language bindings, where each callback crossing is expensive
+ *
+ * \see
+ * TLN_SetRasterCallback()
+ */
+bool TLN_SetRasterInterrupts (TLN_RasterInterrupt* interrupts, int count)
+{
+	TLN_RasterInterrupt* list = engine->interrupts.list;
+	int c, d;
+
+	if (interrupts == NULL || count <= 0)
+		count = 0;
+	else
+	{
+		/* grow only: re-arming from a callback every frame doesn't allocate */
+		if (count > engine->interrupts.capacity)
+		{
+			list = malloc (count * sizeof(TLN_RasterInterrupt));
+			CountAllocation (count * sizeof(TLN_RasterInterrupt));
+			if (list == NULL)
+			{
+				TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+				return false;
+			}
+			free (engine->interrupts.list);
+			engine->interrupts.list = list;
+			engine->interrupts.capacity = count;
+		}
+
+		/* insertion sort: keeps registration order of interrupts sharing the same line */
+		for (c=0; c<count; c++)
+		{
+			for (d=c; d>0 && list[d - 1].line > interrupts[c].line; d--)
+				list[d] = list[d - 1];
+			list[d] = interrupts[c];
+		}
+	}
+	engine->interrupts.count = count;
+
+	/* lines already drawn in the current frame don't fire again. TLN_BeginFrame() rewinds */
+	for (c=0; c<count && list[c].line <= engine->line; c++);
+	engine->interrupts.next = c;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
 /*!
  * \brief
  * Specifies the address of the funcion to call for each drawn frame
@@ -543,6 +697,28 @@ void TLN_DisableBGColor (void)
 	engine->bgcolor = 0;
 }
 
+/*!
+ * \brief
+ * Enables transparent output with premultiplied alpha, for compositing the frame over other content
+ * 
+ * \param enable
+ * true to enable, false to return to opaque output (default)
+ * 
+ * \remarks
+ * When enabled, pixels not covered by any layer, sprite or background bitmap are left fully transparent
+ * instead of filled with the background color. Blended layers and sprites raise the alpha of the
+ * pixels below them by the opacity of their blending mode, so the framebuffer holds premultiplied
+ * alpha that can be composited directly with the "source over" operator
+ * 
+ * \see
+ * TLN_SetBGColor(), TLN_SetBGBitmap()
+ */
+void TLN_SetPremultipliedOutput (bool enable)
+{
+	engine->premultiplied = enable;
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
 /*!
  * \brief
  * Sets a static bitmap as background
@@ -619,6 +795,228 @@ void TLN_SetCustomBlendFunction (uint8_t (*blend_function)(uint8_t src, uint8_t
 	}
 }
 
+/*!
+ * \brief
+ * Enables or disables the cache of tiles resolved to 32 bpp
+ *
+ * \param numtiles
+ * Number of tile/palette combinations to keep, or 0 to disable the cache
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Regular layers translate each tile line through its palette every time it is drawn. With the
+ * cache enabled, the most recently used tiles are kept already translated with the palette they
+ * were drawn with, so opaque tile lines are drawn with a plain memory copy. Cached tiles are
+ * refreshed automatically when the tileset or palette is modified through the API, and discarded
+ * in least recently used order when the cache is full. Blended, mosaic and transformed layers
+ * don't use the cache
+ */
+bool TLN_SetTileCache (int numtiles)
+{
+	TileCache* cache = NULL;
+
+	if (numtiles > 0)
+	{
+		cache = CreateTileCache (numtiles);
+		if (cache == NULL)
+		{
+			TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+			return false;
+		}
+	}
+
+	DeleteTileCache (engine->tilecache);
+	engine->tilecache = cache;
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Enables drawing horizontally flipped tiles and sprites from mirrored copies
+ *
+ * \param enable
+ * true to enable, false to draw them in reverse order (default)
+ *
+ * \remarks
+ * Tiles and sprites with FLAG_FLIPX are normally drawn reading their pixels backwards. When
+ * enabled, a mirrored copy of each flipped tile or sprite is made the first time it's drawn, so
+ * all of them are read forwards like the unflipped ones. Copies are kept in memory reported by
+ * TLN_GetUsedMemory() until the tileset or spriteset is deleted. Tile copies are refreshed when
+ * the tileset is modified through the API, sprite copies when TLN_SetSpritesetData() is called.
+ * Affine and per-pixel mapped layers, and rotated sprites, don't use the copies
+ *
+ * \see
+ * TLN_SetTileCache()
+ */
+void TLN_SetPreflippedGraphics (bool enable)
+{
+	engine->preflip = enable;
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
+/*!
+ * \brief
+ * Enables recording which object draws each pixel of the frame
+ *
+ * \param enable
+ * true to fill an object ID buffer while drawing, false to disable it and free its memory
+ *
+ * \returns
+ * true if success or false if there isn't enough memory
+ *
+ * \remarks
+ * When enabled, each opaque pixel drawn by a sprite or a layer records who drew it, so picking
+ * and hit-testing become a single read with TLN_GetObjectAt() after the frame. Tiled layers record
+ * the tilemap cell, except with mosaic effect or reduced resolution, where only the layer is
+ * recorded. It adds a pass over the opaque pixels of every object drawn
+ *
+ * \see
+ * TLN_GetObjectAt()
+ */
+bool TLN_SetObjectIdBuffer (bool enable)
+{
+	const int width = engine->framebuffer.width;
+
+	free (engine->ids.buffer);
+	free (engine->ids.priority);
+	engine->ids.buffer = NULL;
+	engine->ids.priority = NULL;
+	engine->ids.line = NULL;
+
+	if (enable)
+	{
+		engine->ids.buffer = calloc (width * engine->framebuffer.height, sizeof(uint32_t));
+		engine->ids.priority = calloc (width, sizeof(uint32_t));
+		CountAllocation ((width * engine->framebuffer.height + width) * sizeof(uint32_t));
+		if (engine->ids.buffer == NULL || engine->ids.priority == NULL)
+		{
+			free (engine->ids.buffer);
+			free (engine->ids.priority);
+			engine->ids.buffer = NULL;
+			engine->ids.priority = NULL;
+			TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+			return false;
+		}
+	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Returns the object that drew a pixel in the last frame
+ *
+ * \param x
+ * Horizontal position inside the framebuffer
+ *
+ * \param y
+ * Vertical position inside the framebuffer
+ *
+ * \param info
+ * Pointer to a TLN_ObjectInfo struct that receives the object: OBJECT_SPRITE with its sprite
+ * index, OBJECT_TILE with the layer index and tilemap row and column, OBJECT_LAYER with the layer
+ * index, or OBJECT_NONE if only the background was drawn there
+ *
+ * \returns
+ * true if success or false if the ID buffer is disabled or the position is outside the framebuffer
+ *
+ * \remarks
+ * The object reported is the topmost one, the one whose color is on screen, regardless of
+ * blending
+ *
+ * \see
+ * TLN_SetObjectIdBuffer()
+ */
+bool TLN_GetObjectAt (int x, int y, TLN_ObjectInfo* info)
+{
+	uint32_t id;
+
+	if (info == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_NULL_POINTER);
+		return false;
+	}
+	if (engine->ids.buffer == NULL || x < 0 || y < 0 || x >= engine->framebuffer.width || y >= engine->framebuffer.height)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return false;
+	}
+
+	id = engine->ids.buffer[y*engine->framebuffer.width + x];
+	memset (info, 0, sizeof(TLN_ObjectInfo));
+	info->type = (TLN_ObjectType)(id >> 30);
+	switch (info->type)
+	{
+	case OBJECT_SPRITE:
+		info->index = id & 0x3FFFFFFF;
+		break;
+
+	case OBJECT_TILE:
+		{
+			const TLN_Tilemap tilemap = engine->layers[(id >> 24) & 0x3F].tilemap;
+			const int cell = id & 0xFFFFFF;
+			info->index = (id >> 24) & 0x3F;
+			if (tilemap != NULL)
+			{
+				info->row = cell / tilemap->cols;
+				info->col = cell % tilemap->cols;
+			}
+		}
+		break;
+
+	case OBJECT_LAYER:
+		info->index = (id >> 24) & 0x3F;
+		break;
+
+	default:
+		break;
+	}
+	TLN_SetLastError (TLN_ERR_OK);
+	return true;
+}
+
+/*!
+ * \brief
+ * Sets what to do when the engine allocates memory during frames
+ *
+ * \param policy
+ * ALLOC_ALLOW to allow allocations at any time (default), ALLOC_REPORT to log each one, or
+ * ALLOC_TRAP to log and abort the program on the first one
+ *
+ * \remarks
+ * The policy is enforced from the next call to TLN_BeginFrame() (or TLN_UpdateFrame()) on, so
+ * resources can still be loaded and created between setting the policy and starting the first
+ * frame. From then on any allocation made by the engine, during rendering or by API calls made
+ * between frames, is considered a violation. Use it to check that a game reaches a steady state
+ * without allocations once loaded. Violations are logged as errors, so they're printed only when
+ * the log level set with TLN_SetLogLevel() is TLN_LOG_ERRORS or higher
+ *
+ * \see
+ * TLN_GetFrameAllocations(), TLN_SetLogLevel()
+ */
+void TLN_SetStrictAllocation (TLN_AllocationPolicy policy)
+{
+	engine->allocs.policy = policy;
+	engine->allocs.armed = false;
+	TLN_SetLastError (TLN_ERR_OK);
+}
+
+/*!
+ * \brief
+ * Returns the number of memory allocations made by the engine since the last TLN_BeginFrame()
+ *
+ * \remarks
+ * Allocations are counted whatever the policy set with TLN_SetStrictAllocation()
+ */
+uint32_t TLN_GetFrameAllocations (void)
+{
+	TLN_SetLastError (TLN_ERR_OK);
+	return engine->allocs.count;
+}
+
 /*!
  * \brief
  * Returns the number of objets used by the engine so far
@@ -668,6 +1066,8 @@ const char* const errornames[] =
 	"Resource file has invalid format",
 	"A width or height parameter is invalid",
 	"Unsupported function",
+	"Invalid Snapshot reference",
+	"Light index out of range",
 };
 
 /*!
@@ -26,6 +26,7 @@
 #undef __STRICT_ANSI__
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "Tilengine.h"
@@ -33,8 +34,11 @@
 #include "Palette.h"
 #include "simplexml.h"
 #include "Bitmap.h"
+#include "LoadFile.h"
 
+static TLN_Tileset CreateTileset (int numtiles, int numstored, int width, int height, TLN_Palette palette, TLN_SequencePack sp, TLN_TileAttributes* attributes);
 static bool HasTransparentPixels (uint8_t* src, int width);
+static void DeleteResidentTiles (TLN_Tileset tileset);
 
 /*!
  * \brief
@@ -65,6 +69,126 @@ static bool HasTransparentPixels (uint8_t* src, int width);
  * TLN_SetTilesetPixels()
  */
 TLN_Tileset TLN_CreateTileset (int numtiles, int width, int height, TLN_Palette palette, TLN_SequencePack sp, TLN_TileAttributes* attributes)
+{
+	return CreateTileset (numtiles, numtiles, width, height, palette, sp, attributes);
+}
+
+/*!
+ * \brief
+ * Creates a virtual tileset, whose pixels are read from a pack file as they're needed
+ *
+ * \param filename
+ * Pack file with the pixels of all the tiles
+ *
+ * \param offset
+ * Position of the first tile inside the file, to keep the tiles inside a bigger archive
+ *
+ * \param numtiles
+ * Number of tiles in the pack file
+ *
+ * \param width
+ * Width of each tile (power of two)
+ *
+ * \param height
+ * Height of each tile (power of two)
+ *
+ * \param palette
+ * Reference to the palette to assign
+ *
+ * \param attributes
+ * Optional array of attributes, one for each tile. Can be NULL
+ *
+ * \param numresident
+ * Number of tiles kept in memory at a time
+ *
+ * \returns
+ * Reference to the created tileset, or NULL if error
+ *
+ * \remarks
+ * The pack file holds the tiles one after another starting at the given offset, each one as
+ * width*height palette indexes, row by row. Only numresident tiles are kept in memory: a tile
+ * that isn't resident is read from the file when a layer draws it, replacing one that hasn't been
+ * drawn recently. At the start of each frame, the tiles of the rows and columns about to scroll
+ * into view are read in advance. The file stays open until the tileset is deleted. The pixels of
+ * a virtual tileset can't be modified, so it doesn't support TLN_SetTilesetPixels(), TLN_CopyTile(),
+ * tileset animations or TLN_CloneTileset()
+ *
+ * \see
+ * TLN_CreateTileset()
+ */
+TLN_Tileset TLN_CreateVirtualTileset (const char* filename, int offset, int numtiles, int width, int height, TLN_Palette palette, TLN_TileAttributes* attributes, int numresident)
+{
+	TLN_Tileset tileset;
+	TileResidency* resident;
+	FILE* pf;
+	long size;
+	int y;
+
+	if (filename == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_NULL_POINTER);
+		return NULL;
+	}
+	if (numtiles < 1 || numresident < 1 || offset < 0)
+	{
+		TLN_SetLastError (TLN_ERR_WRONG_SIZE);
+		return NULL;
+	}
+	if (numresident > numtiles)
+		numresident = numtiles;
+
+	/* the file must hold all the tiles */
+	pf = FileOpen (filename);
+	if (pf == NULL)
+	{
+		TLN_SetLastError (TLN_ERR_FILE_NOT_FOUND);
+		return NULL;
+	}
+	fseek (pf, 0, SEEK_END);
+	size = ftell (pf);
+	if (size < offset + (long)numtiles*width*height)
+	{
+		fclose (pf);
+		TLN_SetLastError (TLN_ERR_WRONG_FORMAT);
+		return NULL;
+	}
+
+	tileset = CreateTileset (numtiles, numresident, width, height, palette, NULL, attributes);
+	if (tileset == NULL)
+	{
+		fclose (pf);
+		return NULL;
+	}
+
+	size = sizeof(TileResidency) + (numtiles + 1) * sizeof(int) + (numresident + 1) * (sizeof(int) + sizeof(bool));
+	resident = calloc (size, 1);
+	if (resident == NULL)
+	{
+		fclose (pf);
+		DeleteBaseObject (tileset);
+		TLN_SetLastError (TLN_ERR_OUT_OF_MEMORY);
+		return NULL;
+	}
+	AddObjectMemory (size);
+	resident->file = pf;
+	resident->offset = offset;
+	resident->numslots = numresident;
+	resident->hand = 1;
+	resident->slot = (int*)(resident + 1);
+	resident->tile = resident->slot + numtiles + 1;
+	resident->used = (bool*)(resident->tile + numresident + 1);
+	tileset->resident = resident;
+
+	/* slot 0 is the empty tile drawn when a tile can't be read: fully transparent */
+	for (y=0; y<height; y++)
+		tileset->color_key[y] = true;
+
+	TLN_SetLastError (TLN_ERR_OK);
+	return tileset;
+}
+
+/* creates a tileset with numtiles tiles, storage for numstored of them, and their attributes */
+static TLN_Tileset CreateTileset (int numtiles, int numstored, int width, int height, TLN_Palette palette, TLN_SequencePack sp, TLN_TileAttributes* attributes)
 {
 	TLN_Tileset tileset;
 	int hshift = 0;
@@ -90,8 +214,9 @@ TLN_Tileset TLN_CreateTileset (int numtiles, int width, int height, TLN_Palette
 	}
 
 	numtiles++;
-	size_tiles = width * height * numtiles;
-	size_color = height * numtiles;
+	numstored++;
+	size_tiles = width * height * numstored;
+	size_color = height * numstored;
 	size_attributes = sizeof(TLN_TileAttributes) * numtiles;
 	size = sizeof(struct Tileset) + size_tiles + size_color + size_attributes;
 	tileset = CreateBaseObject (OT_TILESET, size);
@@ -109,10 +234,11 @@ TLN_Tileset TLN_CreateTileset (int numtiles, int width, int height, TLN_Palette
 	tileset->size_color = size_color;
 	tileset->palette = palette;
 	tileset->sp = sp;
+	tileset->version = NewObjectVersion ();
 	tileset->color_key = (bool*)(tileset->data + tileset->size_tiles);
 	tileset->attributes = (TLN_TileAttributes*)(tileset->data + tileset->size_tiles + tileset->size_color);
 	if (attributes != NULL)
-		memcpy (tileset->attributes, attributes, size_attributes);
+		memcpy (tileset->attributes, attributes, size_attributes - sizeof(TLN_TileAttributes));
 	
 	TLN_SetLastError (TLN_ERR_OK);
 	return tileset;
@@ -151,6 +277,12 @@ bool TLN_SetTilesetPixels (TLN_Tileset tileset, int entry, uint8_t* srcdata, int
 	if (!CheckBaseObject (tileset, OT_TILESET))
 		return false;
 
+	if (tileset->resident != NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
 	if (entry<1 || entry>tileset->numtiles)
 	{
 		TLN_SetLastError (TLN_ERR_IDX_PICTURE);
@@ -166,6 +298,7 @@ bool TLN_SetTilesetPixels (TLN_Tileset tileset, int entry, uint8_t* srcdata, int
 		srcdata += srcpitch;
 		dstdata += tileset->width;
 	}
+	tileset->version = NewObjectVersion ();
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -191,12 +324,21 @@ TLN_Tileset TLN_CloneTileset (TLN_Tileset src)
 	if (!CheckBaseObject (src, OT_TILESET))
 		return NULL;
 
+	if (src->resident != NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return NULL;
+	}
+
 	tileset = CloneBaseObject (src);
 	if (tileset)
 	{
 		TLN_SetLastError (TLN_ERR_OK);
 		tileset->color_key = (bool*)(tileset->data + tileset->size_tiles);
 		tileset->attributes = (TLN_TileAttributes*)(tileset->data + tileset->size_tiles + tileset->size_color);
+		tileset->flipped = NULL;
+		tileset->flipversion = NULL;
+		tileset->blocked = NULL;
 		return tileset;
 	}
 	else
@@ -222,9 +364,13 @@ bool TLN_DeleteTileset (TLN_Tileset tileset)
 	{
 		if (ObjectOwner (tileset))
 		{
+			DeleteGradedPalette (tileset->palette);
 			DeleteBaseObject (tileset->palette);
 			DeleteBaseObject (tileset->sp);
 		}
+		DeleteFlippedTiles (tileset);
+		DeleteBlockedTiles (tileset);
+		DeleteResidentTiles (tileset);
 		DeleteBaseObject (tileset);
 		TLN_SetLastError (TLN_ERR_OK);
 		return true;
@@ -345,6 +491,12 @@ bool TLN_CopyTile (TLN_Tileset tileset, int src, int dst)
 	if (!CheckBaseObject (tileset, OT_TILESET))
 		return false;
 
+	if (tileset->resident != NULL)
+	{
+		TLN_SetLastError (TLN_ERR_UNSUPPORTED);
+		return false;
+	}
+
 	if (src>=tileset->numtiles)
 	{
 		TLN_SetLastError (TLN_ERR_IDX_PICTURE);
@@ -364,6 +516,7 @@ bool TLN_CopyTile (TLN_Tileset tileset, int src, int dst)
 	dstdata = tileset->data + (dst * tilesize);
 	memcpy (dstdata, srcdata, tilesize);
 	memcpy (&tileset->color_key[dst*tileset->height], &tileset->color_key[src*tileset->height], tileset->height);
+	tileset->version = NewObjectVersion ();
 
 	TLN_SetLastError (TLN_ERR_OK);
 	return true;
@@ -381,3 +534,195 @@ static bool HasTransparentPixels (uint8_t* src, int width)
 	}
 	return false;
 }
+
+/* returns the horizontally mirrored copy of a tile, made on first use or after the tileset
+ * changes, so FLAG_FLIPX tiles are drawn forwards. NULL if there isn't memory for the copies */
+uint8_t* GetFlippedTile (TLN_Tileset tileset, int index)
+{
+	const int tilesize = tileset->width * tileset->height;
+	uint8_t* dst;
+	const uint8_t* src;
+	int x,y;
+
+	if (tileset->flipped == NULL)
+	{
+		const int size = tileset->size_tiles + tileset->numtiles * sizeof(uint32_t);
+		tileset->flipped = malloc (size);
+		if (tileset->flipped == NULL)
+			return NULL;
+		tileset->flipversion = (uint32_t*)(tileset->flipped + tileset->size_tiles);
+		memset (tileset->flipversion, 0, tileset->numtiles * sizeof(uint32_t));
+		AddObjectMemory (size);
+	}
+
+	dst = tileset->flipped + index*tilesize;
+	if (tileset->flipversion[index] != tileset->version)
+	{
+		src = tileset->data + index*tilesize;
+		for (y=0; y<tileset->height; y++)
+		{
+			for (x=0; x<tileset->width; x++)
+				dst[x] = src[tileset->width - x - 1];
+			src += tileset->width;
+			dst += tileset->width;
+		}
+		tileset->flipversion[index] = tileset->version;
+		dst -= tilesize;
+	}
+	return dst;
+}
+
+/* frees the mirrored tiles */
+void DeleteFlippedTiles (TLN_Tileset tileset)
+{
+	if (tileset->flipped == NULL)
+		return;
+
+	AddObjectMemory (-(int)(tileset->size_tiles + tileset->numtiles * sizeof(uint32_t)));
+	free (tileset->flipped);
+	tileset->flipped = NULL;
+	tileset->flipversion = NULL;
+}
+
+/* spreads the bits of a coordinate: the lower ones interleaved every two positions, the ones beyond
+ * the shorter side of the tile packed above */
+static int SpreadBits (int value, int bits, int common, int first)
+{
+	int result = 0;
+	int c;
+
+	for (c=0; c<bits; c++)
+	{
+		if (value & (1 << c))
+			result |= 1 << (c < common? c*2 + first : common + c);
+	}
+	return result;
+}
+
+/* returns a copy of the tiles with the pixels of each one in Morton order, so neighbour pixels in
+ * any direction are close in memory, made on first use or after the tileset changes. Use with
+ * GetBlockedPixel(). NULL if each tile already fits in a cache line (64 bytes), or if there isn't
+ * memory for the copy */
+uint8_t* GetBlockedTiles (TLN_Tileset tileset)
+{
+	const int tilesize = tileset->width * tileset->height;
+	const int common = tileset->hshift < tileset->vshift? tileset->hshift : tileset->vshift;
+	const uint8_t* src;
+	uint8_t* dst;
+	int c,x,y;
+
+	if (tilesize <= 64 || tileset->resident != NULL)
+		return NULL;
+
+	if (tileset->blocked == NULL)
+	{
+		const int size = tileset->size_tiles + (tileset->width + tileset->height) * sizeof(int);
+		tileset->blocked = malloc (size);
+		if (tileset->blocked == NULL)
+			return NULL;
+		tileset->blockx = (int*)(tileset->blocked + tileset->size_tiles);
+		tileset->blocky = tileset->blockx + tileset->width;
+		for (x=0; x<tileset->width; x++)
+			tileset->blockx[x] = SpreadBits (x, tileset->hshift, common, 0);
+		for (y=0; y<tileset->height; y++)
+			tileset->blocky[y] = SpreadBits (y, tileset->vshift, common, 1);
+		tileset->blockversion = 0;
+		AddObjectMemory (size);
+	}
+
+	if (tileset->blockversion != tileset->version)
+	{
+		src = tileset->data;
+		dst = tileset->blocked;
+		for (c=0; c<tileset->numtiles; c++)
+		{
+			for (y=0; y<tileset->height; y++)
+			{
+				for (x=0; x<tileset->width; x++)
+					dst[tileset->blockx[x] + tileset->blocky[y]] = src[x];
+				src += tileset->width;
+			}
+			dst += tilesize;
+		}
+		tileset->blockversion = tileset->version;
+	}
+	return tileset->blocked;
+}
+
+/* frees the blocked tiles */
+void DeleteBlockedTiles (TLN_Tileset tileset)
+{
+	if (tileset->blocked == NULL)
+		return;
+
+	AddObjectMemory (-(int)(tileset->size_tiles + (tileset->width + tileset->height) * sizeof(int)));
+	free (tileset->blocked);
+	tileset->blocked = NULL;
+}
+
+/* returns the slot where a tile of a virtual tileset is resident, reading it from the pack file if
+ * it isn't. The slot replaced is the first one not used since the last pass of a clock hand, so
+ * tiles drawn every frame stay. Returns 0 (empty tile) if the tile can't be read */
+int LoadResidentTile (TLN_Tileset tileset, int index)
+{
+	TileResidency* resident = tileset->resident;
+	const int tilesize = tileset->width * tileset->height;
+	uint8_t* dst;
+	int slot, y;
+
+	if (index < 1 || index >= tileset->numtiles)
+		return 0;
+
+	/* hit */
+	slot = resident->slot[index];
+	if (slot != 0)
+	{
+		resident->used[slot] = true;
+		return slot;
+	}
+
+	/* miss: find a slot to replace */
+	while (true)
+	{
+		slot = resident->hand;
+		resident->hand = resident->hand % resident->numslots + 1;
+		if (!resident->used[slot])
+			break;
+		resident->used[slot] = false;
+	}
+	if (resident->tile[slot] != 0)
+	{
+		resident->slot[resident->tile[slot]] = 0;
+		resident->tile[slot] = 0;
+	}
+
+	/* read pixels */
+	dst = tileset->data + slot*tilesize;
+	if (fseek (resident->file, resident->offset + (long)(index - 1)*tilesize, SEEK_SET) != 0 ||
+		fread (dst, tilesize, 1, resident->file) != 1)
+		return 0;
+
+	for (y=0; y<tileset->height; y++)
+		tileset->color_key[GetTilesetLine (tileset, slot, y)] = HasTransparentPixels (dst + y*tileset->width, tileset->width);
+	if (tileset->flipped != NULL)
+		tileset->flipversion[slot] = 0;
+
+	resident->slot[index] = slot;
+	resident->tile[slot] = index;
+	resident->used[slot] = true;
+	return slot;
+}
+
+/* closes the pack file of a virtual tileset and frees its slot tables */
+static void DeleteResidentTiles (TLN_Tileset tileset)
+{
+	TileResidency* resident = tileset->resident;
+
+	if (resident == NULL)
+		return;
+
+	AddObjectMemory (-(int)(sizeof(TileResidency) + (tileset->numtiles) * sizeof(int) + (resident->numslots + 1) * (sizeof(int) + sizeof(bool))));
+	fclose (resident->file);
+	free (resident);
+	tileset->resident = NULL;
+}
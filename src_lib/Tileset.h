@@ -20,10 +20,24 @@
 #ifndef _TILESET_H
 #define _TILESET_H
 
+#include <stdio.h>
 #include "Object.h"
 #include "Palette.h"
 #include "SequencePack.h"
 
+/* resident tiles of a virtual tileset, read on demand from a pack file into a fixed number of slots */
+typedef struct
+{
+	FILE*	file;			 /* open pack file */
+	long	offset;			 /* position of the first tile inside the file */
+	int		numslots;		 /* number of resident tiles, slot 0 is the empty tile */
+	int		hand;			 /* next slot to check for replacement */
+	int*	slot;			 /* slot holding each tile, 0 = not resident */
+	int*	tile;			 /* tile held in each slot, 0 = free */
+	bool*	used;			 /* slot used since the hand last passed */
+}
+TileResidency;
+
 /* set de tiles */
 struct Tileset
 {
@@ -37,10 +51,18 @@ struct Tileset
 	int		vmask;			 /* mascara vertical */
 	int		size_tiles;		 /* tamao de la seccin de tiles */
 	int		size_color;		 /* tamao de la seccin de color key */
+	uint32_t version;		 /* content version, renewed on every change */
 	struct Palette* palette; /* paleta original */
 	struct SequencePack* sp; /* secuencias asociadas (si hay) */
 	bool*	color_key;		 /* puntero a array indicando si cada lnea tiene color key */
 	TLN_TileAttributes* attributes;	/* puntero a array de atributos, uno por tile */
+	uint8_t* flipped;		 /* horizontally mirrored tiles, NULL until first needed */
+	uint32_t* flipversion;	 /* tileset version each mirrored tile was made from, 0 = none */
+	uint8_t* blocked;		 /* tiles with pixels in Morton order, NULL until first needed */
+	uint32_t blockversion;	 /* tileset version the blocked tiles were made from */
+	int*	blockx;			 /* offset of each column inside a blocked tile */
+	int*	blocky;			 /* offset of each row inside a blocked tile */
+	TileResidency* resident; /* virtual tileset: data holds resident slots instead of tiles, NULL = regular */
 	uint8_t	data[];
 };
 
@@ -50,4 +72,18 @@ struct Tileset
 #define GetTilesetPixel(tileset,index,x,y) \
 	tileset->data[(((index << tileset->vshift) + y) << tileset->hshift) + x]
 
+/* storage index of a tile: itself, or the slot it's loaded into in virtual tilesets. Use it in
+ * place of the tile index for data, color_key, and mirrored copies, but not for attributes */
+#define GetResidentTile(tileset,index) \
+	((tileset)->resident == NULL? (index) : LoadResidentTile (tileset, index))
+
+int LoadResidentTile (TLN_Tileset tileset, int index);
+uint8_t* GetFlippedTile (TLN_Tileset tileset, int index);
+void DeleteFlippedTiles (TLN_Tileset tileset);
+uint8_t* GetBlockedTiles (TLN_Tileset tileset);
+void DeleteBlockedTiles (TLN_Tileset tileset);
+
+#define GetBlockedPixel(blocked,tileshift,blockx,blocky,index,x,y) \
+	(blocked)[((index) << (tileshift)) + (blockx)[x] + (blocky)[y]]
+
 #endif
@@ -70,6 +70,18 @@ PlayerInput;
 
 static PlayerInput player_inputs[MAX_PLAYERS];
 
+/* input transitions, single producer (thread processing the window) and single consumer
+ * (thread calling TLN_GetInputEvent), lock-free */
+#define MAX_EVENTS	256		/* power of two */
+struct
+{
+	TLN_InputEvent events[MAX_EVENTS];
+	SDL_atomic_t head;	/* next slot to write, only modified by the producer */
+	SDL_atomic_t tail;	/* next slot to read, only modified by the consumer */
+	uint32_t time;		/* timestamp of the SDL event being processed */
+}
+static input_events;
+
 
 /* CRT effect */
 struct
@@ -376,14 +388,14 @@ static int WindowThread (void* data)
 	int time = 0;
 	bool ok;
 
+	/* report result to TLN_CreateWindowThread() */
 	ok = CreateWindow ();
-	if (ok == true)
-		wnd_params.retval = 1;
-	else
-	{
-		wnd_params.retval = 2;
+	SDL_LockMutex (lock);
+	wnd_params.retval = ok? 1 : 2;
+	SDL_CondSignal (cond);
+	SDL_UnlockMutex (lock);
+	if (!ok)
 		return 0;
-	}
 
 	/* main loop */
 	while (TLN_IsWindowActive())
@@ -502,9 +514,11 @@ bool TLN_CreateWindowThread (const char* overlay, TLN_WindowFlags flags)
 	cond = SDL_CreateCond ();
 
 	/* init thread & wait window creation result */
+	SDL_LockMutex (lock);
 	thread = SDL_CreateThread (WindowThread, "WindowThread", &wnd_params);
-	while (wnd_params.retval == 0)
-		SDL_Delay (10);
+	while (thread != NULL && wnd_params.retval == 0)
+		SDL_CondWait (cond, lock);
+	SDL_UnlockMutex (lock);
 
 	if (wnd_params.retval == 1)
 		return true;
@@ -536,9 +550,29 @@ void TLN_DeleteWindow (void)
 	SDL_Quit ();
 }
 
+/* queues an input transition, dropped if the ring is full (the state is still tracked) */
+static void PushInputEvent (TLN_Player player, TLN_Input input, bool pressed)
+{
+	const int head = SDL_AtomicGet (&input_events.head);
+	const int next = (head + 1) & (MAX_EVENTS - 1);
+	TLN_InputEvent* event;
+
+	if (next == SDL_AtomicGet (&input_events.tail))
+		return;
+
+	event = &input_events.events[head];
+	event->time = input_events.time;
+	event->player = player;
+	event->input = input;
+	event->pressed = pressed;
+	SDL_AtomicSet (&input_events.head, next);
+}
+
 /* marks input as pressed */
 static void SetInput (TLN_Player player, TLN_Input input)
 {
+	if (!(player_inputs[player].inputs & (1 << input)))
+		PushInputEvent (player, input, true);
 	player_inputs[player].inputs |= (1 << input);
 	last_key = input;
 }
@@ -546,6 +580,8 @@ static void SetInput (TLN_Player player, TLN_Input input)
 /* marks input as unpressed */
 static void ClrInput (TLN_Player player, TLN_Input input)
 {
+	if (player_inputs[player].inputs & (1 << input))
+		PushInputEvent (player, input, false);
 	player_inputs[player].inputs &= ~(1 << input);
 }
 
@@ -649,6 +685,7 @@ bool TLN_ProcessWindow (void)
 	/* dispatch message queue */
 	while (SDL_PollEvent (&evt))
 	{
+		input_events.time = evt.common.timestamp;
 		switch (evt.type)
 		{
 		case SDL_QUIT:
@@ -879,6 +916,39 @@ bool TLN_GetInput (TLN_Input input)
 	return (player_inputs[player].inputs & (1 << (input & 0xF))) != 0;
 }
 
+/*!
+ * \brief
+ * Gets the oldest pending input transition
+ * 
+ * \param event
+ * Pointer to a TLN_InputEvent that receives the player, the input, whether it was pressed or
+ * released, and when it happened
+ * 
+ * \returns
+ * true if an event was returned, false if there are no more pending events
+ * 
+ * \remarks
+ * Every press and release of the enabled players is queued in order with the timestamp of
+ * the original window event, so taps shorter than a frame aren't lost. Call it in a loop
+ * each frame until it returns false. With TLN_CreateWindowThread() the queue is filled by
+ * the window thread and can be read from the game thread without locking, as long as a
+ * single thread reads it. Up to 255 events are kept, newer ones are dropped when full.
+ * 
+ * \see
+ * TLN_GetInput(), TLN_CreateWindowThread()
+ */
+bool TLN_GetInputEvent (TLN_InputEvent* event)
+{
+	const int tail = SDL_AtomicGet (&input_events.tail);
+
+	if (event == NULL || tail == SDL_AtomicGet (&input_events.head))
+		return false;
+
+	*event = input_events.events[tail];
+	SDL_AtomicSet (&input_events.tail, (tail + 1) & (MAX_EVENTS - 1));
+	return true;
+}
+
 /*!
  * \brief
  * Enables or disables input for specified player
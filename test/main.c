@@ -1,5 +1,8 @@
 #include "Tilengine.h"
 
+/* not published in Tilengine.h yet */
+bool TLN_SetSpriteRotation (int nsprite, float angle);
+
 #define WIDTH	400
 #define HEIGHT	240
 
@@ -43,6 +46,17 @@ int main (int argc, char* argv[])
 
 	TLN_UpdateFrame(0);
 
+	/* test sprite update queue: move and rotate every sprite in the same frame */
+	for (c = 0; c < TLN_GetNumSprites() && spriteset != NULL; c++)
+		TLN_ConfigSprite(c, spriteset, 0);
+	TLN_UpdateFrame(1);
+	for (c = 0; c < TLN_GetNumSprites() && spriteset != NULL; c++)
+	{
+		TLN_SetSpritePosition(c, 20 + c, 20);
+		TLN_SetSpriteRotation(c, 30.0f);
+	}
+	TLN_UpdateFrame(2);
+
 	TLN_DeleteSpriteset(spriteset);
 	TLN_DeleteTilemap(tilemap);
 	TLN_Deinit ();